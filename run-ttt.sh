@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# USAGE: ./run-ttt.sh instance-dir folder targets-file
+
+# inputs
+instancedir=$1
+folder=$2
+targetsfile=$3
+
+mkdir -p ${folder}/ttt
+
+for instance in ${instancedir}/*.csp; do
+  filename=$(basename "$instance")
+  extension="${filename##*.}"
+  filename="${filename%.*}"
+
+  # Targets of this instance: a line "instance:target,target,..." in the targets file
+  targets=$(grep -e "^${filename}:" ${targetsfile} | cut -d: -f2)
+  if [ -z "$targets" ]
+  then
+    continue
+  fi
+
+  for a in as mmas acs; do
+    # Run 25 seeds from 660 and write the run-time distributions of every target to a file
+    if [ $a == as ]
+    then
+    ./ACO-CSP --as --instance ${instance} --budget 1000 --seed 660 --ants 5 --alpha 0.80 --beta 8.37 --rho 0.11 --targets ${targets} --runs 25 --threads 4 > ${folder}/ttt/${filename}-${a}.txt
+    elif [ $a == mmas ]
+    then
+    ./ACO-CSP --mmas --instance ${instance} --budget 1000 --seed 660 --ants 50 --alpha 1.10 --beta 9.84 --rho 0.38 --targets ${targets} --runs 25 --threads 4 > ${folder}/ttt/${filename}-${a}.txt
+    elif [ $a == acs ]
+    then
+    ./ACO-CSP --acs --instance ${instance} --budget 1000 --seed 660 --ants 50 --alpha 2.2 --beta 9.88 --rho 0.25 --q0 0.24 --targets ${targets} --runs 25 --threads 4 > ${folder}/ttt/${filename}-${a}.txt
+    fi
+  done
+done
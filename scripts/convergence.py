@@ -30,7 +30,7 @@ def create_convplots(mode):
                 conv_file = './../output/convergence/algorithms/' + instance + '/out-' + name + '-s' + str(seed) + '.txt'
             elif mode == '-ls':
                 conv_file = './../output/convergence/localsearch/' + instance + '/out-' + name + '-s' + str(seed) + '.txt'
-            data = pd.read_csv(conv_file, sep=':', skipfooter=1)
+            data = pd.read_csv(conv_file, sep=':', skipfooter=1, comment='#')
             for idx, row in data.iterrows():
                 budget = row['budget']
                 quality = row['quality']
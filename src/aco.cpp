@@ -0,0 +1,1015 @@
+//
+//  aco.cpp
+//  ACO-CSP
+//
+
+#include <stdlib.h>
+#include <iostream>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+
+#include "aco.hpp"
+#include "utils.hpp"
+
+/* Weights of the dynamic heuristic: strings weigh dynamic_base, plus up to dynamic_bands the
+   closer they are to the largest distance. Heavier weighting drowns the column frequencies */
+static const long int dynamic_bands = 4;
+static const long int dynamic_base = 12;
+
+/* Constructor */
+ACO::ACO(CSP* csp_arg, Parameters const& params_arg) {
+    params = params_arg;
+    csp = csp_arg;
+    rng = Rng::create(params.rng, params.seed);
+    budget = 0;
+    iterations = 0;
+    solve_budget = params.max_budget;
+    best_string_len = LONG_MAX;
+    best_source = -1;
+    best_distances = NULL;
+    start_time = wallTime();
+    // Only the best ant deposits in MMAS and ACS, so the ants that cannot improve it need no
+    // exact distance. AS deposits with every distance and local search starts from it
+    cutoff = (params.mmas || params.acs) && !params.local;
+    eval_order = NULL;
+    worst_hits = NULL;
+    cut_evaluations = 0;
+    cache = NULL;
+    if (params.cache_size > 0)
+        cache = new SolutionCache(params.cache_size, csp->getStringSize(), params.local);
+    free_hits = 0;
+    archive = NULL;
+    if (params.archive_size > 0)
+        archive = new EliteArchive(csp, params.archive_size, csp->getStringSize() / 100);
+    stagnation = 0;
+    relinks = 0;
+    relink_improvements = 0;
+    ls_share = 1.0;
+    ls_credit = 0.0;
+    b_rep = params.b_rep;
+    construct_gain = 0.0;
+    construct_seconds = 0.0;
+    ls_gain = 0.0;
+    ls_seconds = 0.0;
+    adaptations = 0;
+    model.mode = NULL;
+    model.deviation = NULL;
+    model.block_bound = NULL;
+    model.block = 64;
+    model.mode_distances = NULL;
+    model.mode_hash = 0;
+
+    initializeParameters();
+    pheromone = NULL;
+    heuristic = NULL;
+    probability = NULL;
+    sparse_pheromone = NULL;
+    sparse_probability = NULL;
+    if (params.sparse_pheromone) {
+        initializeSparse();
+    } else {
+        initializePheromone();
+        initializeHeuristic();
+        if (params.dynamic_heuristic)
+            weighHeuristic(true);
+        initializeProbability();
+        calculateProbability();
+    }
+    createColony();
+    probability_next = NULL;
+    update_block = 1024;
+    ready_positions.store(csp->getStringSize());
+    if (params.pipeline) {
+        update_ants = colony;
+        for (int i = 0; i < params.n_ants; i++) {
+            colony[i].setReadyPositions(params.stale ? NULL : &ready_positions);
+        }
+    }
+    if (params.stale) {
+        long int m = csp->getAlphabetSize();
+        long int l = csp->getStringSize();
+        probability_next = new double* [m];
+        for (int i = 0; i < m; i++) {
+            probability_next[i] = new double[l];
+            for (int j = 0; j < l; j++) {
+                probability_next[i][j] = probability[i][j];
+            }
+        }
+    }
+    if (params.sparse)
+        updateConstructionModel();
+    if (cutoff)
+        resetEvaluationOrder();
+}
+
+/* Destructor */
+ACO::~ACO() {
+    finishUpdate();
+    for(int i = 0; pheromone != NULL && i < csp->getAlphabetSize(); i++){
+        delete[] pheromone[i];
+        delete[] heuristic[i];
+        delete[] probability[i];
+        if (probability_next != NULL)
+            delete[] probability_next[i];
+    }
+    delete sparse_pheromone;
+    delete sparse_probability;
+    delete[] probability_next;
+    delete[] pheromone;
+    delete[] heuristic;
+    delete[] probability;
+    for (size_t i = 0; i < colony.size(); i++) {
+        colony[i].freeAnt();
+    }
+    best_ant.freeAnt();
+    deposit_ant.freeAnt();
+    for (size_t i = 0; i < update_ants.size(); i++) {
+        update_ants[i].freeAnt();
+    }
+    update_best.freeAnt();
+    delete[] best_distances;
+    delete[] eval_order;
+    delete[] worst_hits;
+    delete[] model.mode;
+    delete[] model.deviation;
+    delete[] model.block_bound;
+    delete[] model.mode_distances;
+    delete cache;
+    delete archive;
+    delete rng;
+}
+
+void ACO::printPheromone () {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    printf("\nPheromone:\n");
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < l; j++) {
+            printf(" %4.4lf", sparse_pheromone ? sparse_pheromone->get(i, j) : pheromone[i][j]);
+        }
+        printf("\n");
+    }
+}
+
+void ACO::printProbability () {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    printf("\nProbability:\n");
+    for (int i = 0 ; i < m; i++) {
+        for (int j = 0 ; j < l; j++) {
+            printf(" %4.4lf ", sparse_probability ? sparse_probability->get(i, j) : probability[i][j]);
+        }
+        printf("\n");
+    }
+}
+
+/* Create colony structure */
+void ACO::createColony() {
+    if (params.verbose)
+        std::cout << "Creating colony.\n\n";
+    for (int i = 0 ; i < params.n_ants; i++) {
+        if (params.acs) {
+            colony.push_back(Ant(csp, probability, rng, params.q0));
+        } else {
+            colony.push_back(Ant(csp, probability, rng));
+        }
+        colony.back().setLocalSearchThreads(params.ls_threads);
+        colony.back().setLocalSearchEngine(params.ls_engine);
+        colony.back().setCache(cache);
+        colony.back().setSparseProbability(sparse_probability);
+    }
+}
+
+/* Initialize parameters of the ACO algorithm */
+void ACO::initializeParameters() {
+    initial_pheromone = 1.0 / (double) csp->getAlphabetSize();
+    if (params.mmas) {
+        tau_max = 1.0 / (double) csp->getAlphabetSize();
+        double ratio = (double) csp->getAlphabetSize() * (double) csp->getStringSize();
+        tau_min = tau_max / ratio;
+    }
+}
+
+/* Initialize pheromone with an initial value */
+void ACO::initializePheromone() {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    pheromone = new double* [m];
+    for (int i = 0 ; i < m; i++) {
+        pheromone[i] = new double[l];
+        for (int j = 0; j < l; j++) {
+            if (params.mmas) {
+                pheromone[i][j] = tau_max;
+            } else {
+                pheromone[i][j] = initial_pheromone;
+            }
+        }
+    }
+}
+
+/* Initialize the heuristic information matrix */
+void ACO::initializeHeuristic () {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    heuristic = new double* [m];
+    for (int i = 0 ; i < m; i++) {
+        heuristic[i] = new double[l];
+        for (int j = 0; j < l; j++) {
+            heuristic[i][j] =
+                (double) csp->getCount(i, j) / (double) csp->getSetSize();
+        }
+    }
+}
+
+/* Recompute the heuristic information from the column counts, after the set changed */
+void ACO::updateHeuristic () {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    if (params.dynamic_heuristic) {
+        weighHeuristic(true);
+        return;
+    }
+    for (int i = 0 ; i < m; i++) {
+        for (int j = 0; j < l; j++) {
+            heuristic[i][j] =
+                (double) csp->getCount(i, j) / (double) csp->getSetSize();
+        }
+    }
+}
+
+/* Dynamic heuristic information: the letters of the strings far from the best string count more.
+   Strings within band_width of the largest distance weigh dynamic_bands more than the base weight,
+   every band further down one less. heuristic[i][j] is the summed weight of the strings with letter
+   i at position j over that of n strings of base weight, the frequency while all strings weigh the
+   base. A band is 1/dynamic_bands of the spread of the distances of the best string, so when the
+   spread changes, many weights do. Only the strings whose weight changed are counted again, which
+   leaves the same counts as a rebuild */
+void ACO::weighHeuristic(bool rebuild) {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+    long int n = csp->getSetSize();
+
+    if (rebuild) {
+        string_weight.assign(n, 0);
+        weighted_counts.assign(l * m, 0);
+        for (int i = 0; i < m; i++) {
+            for (long int j = 0; j < l; j++) {
+                heuristic[i][j] = 0.0;
+            }
+        }
+    }
+    long int max_distance = 0;
+    long int min_distance = LONG_MAX;
+    for (int k = 0; best_distances != NULL && k < n; k++) {
+        max_distance = std::max(max_distance, best_distances[k]);
+        min_distance = std::min(min_distance, best_distances[k]);
+    }
+    // The bands follow the spread of the distances of the current best string
+    long int band_width = std::max((max_distance - min_distance) / dynamic_bands, 1L);
+
+    std::vector<long int> changed;
+    std::vector<long int> delta;
+    for (int k = 0; k < n; k++) {
+        long int weight = dynamic_base;
+        if (best_distances != NULL)
+            weight += std::max(dynamic_bands - (max_distance - best_distances[k]) / band_width, 0L);
+        if (weight != string_weight[k]) {
+            changed.push_back(k);
+            delta.push_back(weight - string_weight[k]);
+            string_weight[k] = weight;
+        }
+    }
+    if (changed.empty())
+        return;
+    double base_weight = (double) (n * dynamic_base);
+    for (long int j = 0; j < l; j++) {
+        const unsigned char* col = csp->getColumn(j);
+        for (size_t c = 0; c < changed.size(); c++) {
+            long int i = col[changed[c]];
+            weighted_counts[j * m + i] += delta[c];
+            heuristic[i][j] = (double) weighted_counts[j * m + i] / base_weight;
+        }
+    }
+}
+
+/* Initialize the probability information matrix */
+void ACO::initializeProbability () {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    probability = new double* [m];
+    for (int i = 0; i < m; i++) {
+        probability[i] = new double[l];
+        for (int j = 0; j < l; j++) {
+            probability[i][j] = 0.0;
+        }
+    }
+}
+
+/* Calculate probability using heuristic information and pheromone */
+void ACO::calculateProbability () {
+    calculateProbability(probability, 0, csp->getStringSize());
+}
+
+/* Calculate the probability of positions [begin, end) in prob */
+void ACO::calculateProbability (double** prob, long int begin, long int end) {
+    long int m = csp->getAlphabetSize();
+
+    for (int i = 0; i < m; i++) {
+        for (long int j = begin; j < end; j++) {
+            prob[i][j] =
+                pow(pheromone[i][j], params.alpha) * pow(heuristic[i][j], params.beta);
+        }
+    }
+}
+
+/* Reduce the construction rule to the most likely letter at every position and the probability of
+   another letter. With ACS, the most likely letter is the one taken by exploitation */
+void ACO::updateConstructionModel() {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+    long int blocks = (l + model.block - 1) / model.block;
+
+    if (model.mode == NULL) {
+        model.mode = new long int[l];
+        model.deviation = new double[l];
+        model.block_bound = new double[blocks];
+    }
+    for (long int b = 0; b < blocks; b++) {
+        model.block_bound[b] = 0.0;
+    }
+    for (long int j = 0; j < l; j++) {
+        long int mode = 0;
+        double sum_prob = 0.0;
+        for (long int i = 0; i < m; i++) {
+            sum_prob = sum_prob + probability[i][j];
+            if (probability[i][j] > probability[mode][j])
+                mode = i;
+        }
+        double deviation = (sum_prob > 0.0) ? 1.0 - probability[mode][j] / sum_prob : 0.0;
+        if (params.acs)
+            deviation = (1.0 - params.q0) * deviation;
+        model.mode[j] = mode;
+        model.deviation[j] = deviation;
+        if (j > 0 && deviation > model.block_bound[j / model.block])
+            model.block_bound[j / model.block] = deviation;
+    }
+    // The mode string is usually close to the best string, so it is evaluated from its distances
+    long int n = csp->getSetSize();
+    std::vector<long int> changed;
+    if (best_distances != NULL) {
+        long int* best = best_ant.getString();
+        for (long int j = 0; j < l && (long int) changed.size() <= l / 4; j++) {
+            if (model.mode[j] != best[j])
+                changed.push_back(j);
+        }
+    }
+    delete[] model.mode_distances;
+    if (best_distances != NULL && (long int) changed.size() <= l / 4) {
+        model.mode_distances = new long int[n];
+        csp->getDistance(model.mode, best_ant.getString(), best_distances, changed.data(),
+                         changed.size(), model.mode_distances);
+    } else {
+        model.mode_distances = csp->getAllDistances(model.mode);
+    }
+    if (cache != NULL)
+        model.mode_hash = cache->hash(model.mode);
+}
+
+/* Initialize the sparse pheromone and probability. The heuristic information is not stored, it
+   follows from the column counts */
+void ACO::initializeSparse() {
+    long int m = csp->getAlphabetSize();
+    long int l = csp->getStringSize();
+
+    sparse_pheromone = new SparseMatrix(m, l, params.mmas ? tau_max : initial_pheromone);
+    sparse_probability = new SparseMatrix(m, l, 0.0);
+    calculateSparseProbability();
+}
+
+/* Calculate the sparse probability, as calculateProbability. The baseline of a position is the
+   probability of a letter no string has there */
+void ACO::calculateSparseProbability() {
+    long int m = csp->getAlphabetSize();
+    long int n = csp->getSetSize();
+    std::vector<double> tau(m + 1);
+
+    sparse_probability->update([&](long int j, double* row) {
+        sparse_pheromone->expand(j, tau.data());
+        for (long int i = 0; i < m; i++) {
+            double eta = (double) csp->getCount(i, j) / (double) n;
+            row[i] = pow(tau[i], params.alpha) * pow(eta, params.beta);
+        }
+        row[m] = pow(tau[m], params.alpha) * pow(0.0, params.beta);
+    });
+}
+
+/* Evaporate and deposit on the sparse pheromone, then recompute the probability. Every cell goes
+   through the same operations as on the dense matrix, but only the stored cells and the letters
+   of the depositing ants are visited */
+void ACO::updateSparsePheromone() {
+    long int l = csp->getStringSize();
+    double total_weight = (double) csp->getTotalWeight();
+    Ant& best = depositingAnt();
+    auto bound = [this](double tau) {
+        if (tau > tau_max) {
+            tau = tau_max;
+        } else if (tau < tau_min) {
+            tau = tau_min;
+        }
+        return tau;
+    };
+    auto evaporate = [&](double tau) {
+        tau = (double) (1.0 - params.rho) * tau;
+        return params.mmas ? bound(tau) : tau;
+    };
+
+    // The local updates of the iteration come first, in the order of the ants
+    if (!local_letters.empty()) {
+        long int ants = (long int) local_letters.size() / l;
+        sparse_pheromone->transform([](double tau) { return tau; }, [&](long int j, SparseMatrix::Row& row) {
+            for (long int a = 0; a < ants; a++) {
+                long int i = local_letters[a * l + j];
+                row.set(i, ((1.0 - params.rho) * row.get(i)) + (params.rho * initial_pheromone));
+            }
+        });
+        local_letters.clear();
+    }
+
+    if (params.mmas) {
+        sparse_pheromone->transform([&](double tau) {
+            return bound(evaporate(tau) + params.rho * tau_min);
+        }, [&](long int j, SparseMatrix::Row& row) {
+            long int i = best.getLetter(j);
+            row.set(i, bound(evaporate(row.get(i)) + params.rho * tau_max));
+        });
+    } else if (params.acs) {
+        double deltaf = 1.0 - ((double) best.getStringDistance() / total_weight);
+        sparse_pheromone->transform(evaporate, [&](long int j, SparseMatrix::Row& row) {
+            long int i = best.getLetter(j);
+            row.set(i, evaporate(row.get(i)) + deltaf);
+        });
+    } else if (params.as) {
+        sparse_pheromone->transform(evaporate, [&](long int j, SparseMatrix::Row& row) {
+            for (int a = 0; a < params.n_ants; a++) {
+                double deltaf = 1.0 - ((double) colony[a].getStringDistance() / total_weight);
+                long int i = colony[a].getLetter(j);
+                double tau = row.isSet(i) ? row.get(i) : evaporate(row.get(i));
+                row.set(i, tau + deltaf);
+            }
+        });
+    }
+    calculateSparseProbability();
+}
+
+/* Local pheromone update rule of ACS on the sparse pheromone. The ants construct from the
+   probability, which only changes at the end of the iteration, so the letters of the ant are kept
+   and the rule is applied with the global update, in O(l) per ant */
+void ACO::localSparseUpdate(Ant& ant) {
+    long int l = csp->getStringSize();
+    for (long int j = 0; j < l; j++) {
+        local_letters.push_back((unsigned char) ant.getLetter(j));
+    }
+}
+
+/* Bound pheromone to range [tau_min, tau_max] */
+void ACO::boundPheromone(long int i, long int j) {
+    if (pheromone[i][j] > tau_max) {
+        pheromone[i][j] = tau_max;
+    } else if (pheromone[i][j] < tau_min) {
+        pheromone[i][j] = tau_min;
+    }
+}
+
+/* Pheromone evaporation of positions [begin, end) */
+void ACO::evaporatePheromone(long int begin, long int end) {
+    long int m = csp->getAlphabetSize();
+
+    for (int i = 0; i < m; i++) {
+        for (long int j = begin; j < end; j++) {
+            pheromone[i][j] = (double) (1.0 - params.rho) * pheromone[i][j];
+            if (params.mmas)
+                boundPheromone(i, j);
+        }
+    }
+}
+
+/* Pheromone evaporation of best string only */
+void ACO::evaporatePheromone(Ant& best_ant) {
+    long int l = csp->getStringSize();
+
+    for (int j = 0; j < l; j++) {
+        // Get the idx in the alphabet of the j'th letter
+        // of the ant's solution string
+        long int i = best_ant.getLetter(j);
+        pheromone[i][j] = (double) (1.0 - params.rho) * pheromone[i][j];
+
+        if (params.mmas) {
+            boundPheromone(i, j);
+        }
+    }
+}
+
+/* Adds pheromone to the matrix */
+void ACO::addPheromone(long int i, long int j, double delta) {
+    pheromone[i][j] = pheromone[i][j] + delta;
+
+    if (params.mmas) {
+        boundPheromone(i, j);
+    }
+}
+
+/* Update pheromone of positions [begin, end) with all ants */
+void ACO::depositPheromone(std::vector<Ant>& ants, long int begin, long int end){
+    double deltaf;
+
+    for (int a = 0; a < params.n_ants; a++) {
+        deltaf = 1.0 - ((double) ants[a].getStringDistance() / (double) csp->getTotalWeight());
+        for (long int j = begin; j < end; j++) {
+            // Get the idx in the alphabet of the j'th letter
+            // of the ant's solution string
+            long int i = ants[a].getLetter(j);
+            addPheromone(i, j, deltaf);
+        }
+    }
+}
+
+/* Update pheromone of positions [begin, end) with the best string only */
+void ACO::depositPheromone(Ant& best_ant, long int begin, long int end) {
+    long int m = csp->getAlphabetSize();
+    double deltaf;
+
+    if (params.mmas) {
+        for (int i = 0; i < m; i++) {
+            for (long int j = begin; j < end; j++) {
+                long int letter = best_ant.getLetter(j);
+                if (letter == i) {
+                    deltaf = params.rho * tau_max;
+                } else {
+                    deltaf = params.rho * tau_min;
+                }
+                addPheromone(i, j, deltaf);
+            }
+        }
+    } else {
+        deltaf = 1.0 - ((double) best_ant.getStringDistance() / (double) csp->getTotalWeight());
+        for (long int j = begin; j < end; j++) {
+            long int i = best_ant.getLetter(j);
+            addPheromone(i, j, deltaf);
+        }
+    }
+}
+
+/* Evaporate, deposit and recompute the probability (in prob) of positions [begin, end) */
+void ACO::updatePheromone(std::vector<Ant>& ants, Ant& best, double** prob, long int begin, long int end) {
+    evaporatePheromone(begin, end);
+    if (params.mmas || params.acs) {
+        // Only the best ant deposits pheromone
+        depositPheromone(best, begin, end);
+    } else if (params.as) {
+        // All ants deposit pheromone
+        depositPheromone(ants, begin, end);
+    }
+    calculateProbability(prob, begin, end);
+}
+
+/* The ant MMAS and ACS deposit on. The published runs kept the best string in the buffer of the ant
+   that found it, so they deposited on what that ant built since, at the best distance. That stays
+   the default to reproduce them; with copy_best the deposit is on the best string itself */
+Ant& ACO::depositingAnt() {
+    if (params.copy_best || best_source < 0)
+        return best_ant;
+    deposit_ant = colony[best_source];
+    deposit_ant.setStringDistance(best_ant.getStringDistance());
+    return deposit_ant;
+}
+
+/* Start the pheromone update of this iteration on its own thread, block of positions by block.
+   It works on copies of the depositing ants, as the next iteration builds new solutions */
+void ACO::startUpdate() {
+    long int l = csp->getStringSize();
+    if (params.mmas || params.acs) {
+        update_best = depositingAnt();
+    } else if (params.as) {
+        for (int a = 0; a < params.n_ants; a++) {
+            update_ants[a] = colony[a];
+        }
+    }
+    double** prob = params.stale ? probability_next : probability;
+    ready_positions.store(0);
+    updater = std::thread([this, l, prob]() {
+        for (long int b = 0; b < l; b += update_block) {
+            long int e = (b + update_block < l) ? b + update_block : l;
+            updatePheromone(update_ants, update_best, prob, b, e);
+            ready_positions.store(e, std::memory_order_release);
+        }
+    });
+}
+
+/* Wait for the pheromone update to finish. With stale probabilities, the ants now read the
+   probability it computed */
+void ACO::finishUpdate() {
+    if (!updater.joinable())
+        return;
+    updater.join();
+    if (params.stale) {
+        std::swap(probability, probability_next);
+        for (int i = 0; i < params.n_ants; i++) {
+            colony[i].setProbability(probability);
+        }
+    }
+}
+
+/* Check termination condition based on budget */
+bool ACO::terminationCondition(){
+    if (params.max_budget != 0 && budget >= params.max_budget)
+        return(true);
+    return(false);
+}
+
+/* Let solve() run until max_budget solutions are constructed in total */
+void ACO::setBudget(long int max_budget) {
+    params.max_budget = max_budget;
+}
+
+/* Change the threads of the local search of every ant */
+void ACO::setLocalSearchThreads(long int threads) {
+    params.ls_threads = threads;
+    for (int i = 0; i < params.n_ants; i++) {
+        colony[i].setLocalSearchThreads(threads);
+    }
+}
+
+/* Run iterations until the budget is spent */
+void ACO::solve() {
+    while(!terminationCondition()){
+        iterate();
+    }
+    finishUpdate();
+}
+
+/* Run one iteration */
+void ACO::iterate() {
+    long int iteration_best = best_string_len;
+    iterations++;
+    for(int i = 0; i < params.n_ants; i++) {
+        // Construct solution
+        if (cutoff)
+            colony[i].setCutoff(best_string_len, eval_order);
+        colony[i].setReference(best_distances ? best_ant.getString() : NULL, best_distances);
+        long int delta = colony[i].getDeltaEvaluations();
+        double start = params.adaptive ? wallTime() : 0.0;
+        if (params.sparse) {
+            colony[i].SparseSearch(model);
+        } else {
+            colony[i].Search();
+        }
+        long int constructed = colony[i].getStringDistance();
+        // The first string improves on nothing
+        if (params.adaptive && best_string_len != LONG_MAX) {
+            construct_seconds += wallTime() - start;
+            construct_gain += std::max(best_string_len - constructed, 0L);
+        }
+        // The construction waited for the last block of the update, so it is done
+        if (params.pipeline && !params.stale)
+            finishUpdate();
+        if (cutoff && !colony[i].isCacheHit()) {
+            worst_hits[colony[i].getWorstString()]++;
+            if (colony[i].getDeltaEvaluations() == delta && colony[i].getStringDistance() >= best_string_len)
+                cut_evaluations++;
+        }
+        // If Ant Colony System, do local pheromone update
+        if (params.acs && sparse_pheromone != NULL) {
+            localSparseUpdate(colony[i]);
+        } else if (params.acs) {
+            colony[i].LocalPheromoneUpdate(pheromone, params.rho, initial_pheromone);
+        }
+        // If local search, do local search
+        if (params.local && !params.adaptive) {
+            colony[i].LocalSearch(params.b_rep);
+        } else if (params.local && localSearchTurn()) {
+            start = wallTime();
+            colony[i].LocalSearch(b_rep);
+            ls_seconds += (wallTime() - start) * params.ls_threads;
+            ls_gain += std::max(std::min(best_string_len, constructed) - colony[i].getStringDistance(), 0L);
+        }
+        // Check for new local optimum
+        if (best_string_len > colony[i].getStringDistance()) {
+            best_string_len = colony[i].getStringDistance();
+            best_ant = colony[i];
+            best_source = i;
+            updateBestDistances();
+            recordImprovement();
+        }
+        // Solutions found in the cache can be free, up to another budget of them
+        if (colony[i].isCacheHit() && params.free_hits && free_hits < solve_budget) {
+            free_hits++;
+        } else {
+            budget++;
+        }
+    }
+    if (archive != NULL) {
+        for (int i = 0; i < params.n_ants; i++) {
+            // Distances the ant already has are not computed again
+            const long int* dist = colony[i].getDistances();
+            if (dist != NULL) {
+                archive->insert(colony[i].getString(), dist);
+            } else {
+                archive->insert(colony[i].getString(), colony[i].getStringDistance());
+            }
+        }
+        stagnation = (best_string_len < iteration_best) ? 0 : stagnation + 1;
+        if (stagnation >= params.relink && archive->size() >= 2) {
+            relinkArchive();
+            stagnation = 0;
+        }
+    }
+    if (cutoff)
+        updateEvaluationOrder();
+    if (params.adaptive)
+        adaptEffort();
+    // Update pheromones and probabilities
+    if (params.pipeline) {
+        finishUpdate();
+        if (params.dynamic_heuristic)
+            weighHeuristic(false);
+        startUpdate();
+        return;
+    }
+    if (params.dynamic_heuristic)
+        weighHeuristic(false);
+    if (sparse_pheromone != NULL) {
+        updateSparsePheromone();
+    } else {
+        updatePheromone(colony, depositingAnt(), probability, 0, csp->getStringSize());
+    }
+    if (params.sparse)
+        updateConstructionModel();
+}
+
+/* Record a new best string in the history and the trace */
+void ACO::recordImprovement() {
+    Improvement improvement = { budget, wallTime() - start_time, best_string_len };
+    history.push_back(improvement);
+    if (params.trace)
+        printf("%ld:%ld\n", budget, best_string_len);
+}
+
+/* Path relinking between the best member of the archive and every other member, both ways. The
+   solutions found are offered to the archive, and a new best string deposits pheromone like one
+   found by an ant */
+void ACO::relinkArchive() {
+    long int l = csp->getStringSize();
+    long int best = archive->getBest();
+    std::vector< std::vector<long int> > found;
+    std::vector< std::vector<long int> > found_distances;
+    std::vector<long int> quality;
+    std::vector<long int> walk(l);
+    std::vector<long int> walk_distances(csp->getSetSize());
+
+    for (long int a = 0; a < archive->size(); a++) {
+        if (a == best)
+            continue;
+        for (int way = 0; way < 2; way++) {
+            long int from = (way == 0) ? best : a;
+            long int to = (way == 0) ? a : best;
+            long int distance = pathRelink(csp, archive->getSolution(from), archive->getDistances(from),
+                                           archive->getSolution(to), walk.data(), walk_distances.data());
+            if (distance == LONG_MAX)
+                continue;
+            found.push_back(walk);
+            found_distances.push_back(walk_distances);
+            quality.push_back(distance);
+        }
+    }
+    relinks++;
+    for (size_t f = 0; f < found.size(); f++) {
+        archive->insert(found[f].data(), found_distances[f].data());
+        if (quality[f] < best_string_len) {
+            best_string_len = quality[f];
+            std::copy(found[f].begin(), found[f].end(), best_ant.getString());
+            best_ant.setStringDistance(best_string_len);
+            best_source = -1;
+            updateBestDistances();
+            recordImprovement();
+            relink_improvements++;
+        }
+    }
+}
+
+/* Whether the next ant gets local search: of every 1/ls_share ants, one does */
+bool ACO::localSearchTurn() {
+    ls_credit += ls_share;
+    if (ls_credit < 1.0)
+        return false;
+    ls_credit -= 1.0;
+    return true;
+}
+
+/* Compare how much construction and local search improved the best string per second, with
+   older iterations weighing less. If local search did better, more ants get it and, once all do,
+   it goes deeper; if construction did better, local search gets shallower first and then fewer
+   ants get it. Changes are printed in the trace as comment lines. The decisions depend on timings,
+   so runs are not reproducible from the seed alone */
+void ACO::adaptEffort() {
+    const double decay = 0.9;
+    const double step = 1.25;
+    const double min_share = 0.1;
+    const double depth_range = 8.0;     /* depth stays within b_rep / range .. b_rep * range */
+
+    double construct_rate = construct_seconds > 0.0 ? construct_gain / construct_seconds : 0.0;
+    double ls_rate = ls_seconds > 0.0 ? ls_gain / ls_seconds : 0.0;
+    double share = ls_share;
+    double depth = b_rep;
+    if (ls_rate > construct_rate) {
+        if (ls_share < 1.0) {
+            ls_share = std::min(ls_share * step, 1.0);
+        } else {
+            b_rep = std::min(b_rep * step, params.b_rep * depth_range);
+        }
+    } else if (ls_rate < construct_rate) {
+        if (b_rep > params.b_rep / depth_range) {
+            b_rep = std::max(b_rep / step, params.b_rep / depth_range);
+        } else {
+            ls_share = std::max(ls_share / step, min_share);
+        }
+    }
+    if (ls_share != share || b_rep != depth) {
+        adaptations++;
+        if (params.trace)
+            printf("# %ld:adaptive share %.3f depth %g (construction %g/s, local search %g/s)\n",
+                   budget, ls_share, b_rep, construct_rate, ls_rate);
+    }
+    construct_gain *= decay;
+    construct_seconds *= decay;
+    ls_gain *= decay;
+    ls_seconds *= decay;
+}
+
+/* Scan the strings in set order and forget which strings decided evaluations */
+void ACO::resetEvaluationOrder() {
+    long int n = csp->getSetSize();
+    delete[] eval_order;
+    delete[] worst_hits;
+    eval_order = new long int[n];
+    worst_hits = new long int[n];
+    for (int k = 0; k < n; k++) {
+        eval_order[k] = k;
+        worst_hits[k] = 0;
+    }
+    for (int i = 0; i < params.n_ants; i++) {
+        colony[i].setCutoff(LONG_MAX, eval_order);
+    }
+}
+
+/* Scan the strings that most often decided an evaluation first, so later evaluations
+   reach the cutoff after fewer strings */
+void ACO::updateEvaluationOrder() {
+    long int n = csp->getSetSize();
+    long int* hits = worst_hits;
+    std::stable_sort(eval_order, eval_order + n, [hits](long int a, long int b) {
+        return hits[a] > hits[b];
+    });
+}
+
+/* Keep the distances of the best string to every string in the set, to evaluate ants from them and
+   to update them when the set changes */
+void ACO::updateBestDistances() {
+    delete[] best_distances;
+    best_distances = csp->getAllDistances(best_ant.getString());
+}
+
+/* Add a string to the set. The best string is only evaluated against the new string */
+void ACO::addString(const char* string) {
+    long int idx = csp->addString(string);
+    long int* distances = new long int[idx + 1];
+    move(best_distances, distances, idx);
+    distances[idx] = csp->getDistance(best_ant.getString(), idx);
+    delete[] best_distances;
+    best_distances = distances;
+    if (cutoff)
+        resetEvaluationOrder();
+    if (cache != NULL)
+        cache->clear();
+    if (archive != NULL)
+        archive->clear();
+}
+
+/* Remove string i from the set. The last string takes its index */
+void ACO::removeString(long int i) {
+    long int last = csp->getSetSize() - 1;
+    csp->removeString(i);
+    best_distances[i] = best_distances[last];
+    if (cutoff)
+        resetEvaluationOrder();
+    if (cache != NULL)
+        cache->clear();
+    if (archive != NULL)
+        archive->clear();
+}
+
+/* Re-solve after changes to the string set, for another resolve_budget solutions. The heuristic
+   information follows from the column counts (and the distances to the best string) and the
+   pheromone of the previous solve is kept, so a re-solve needs less budget than a cold solve */
+void ACO::resolve(long int resolve_budget) {
+    long int n = csp->getSetSize();
+    best_string_len = 0;
+    for (int k = 0; k < n; k++) {
+        if (best_distances[k] > best_string_len)
+            best_string_len = best_distances[k];
+    }
+    best_ant.setStringDistance(best_string_len);
+    if (params.trace)
+        printf("%ld:%ld\n", budget, best_string_len);
+    if (sparse_pheromone != NULL) {
+        calculateSparseProbability();
+    } else {
+        updateHeuristic();
+        calculateProbability();
+    }
+    if (params.sparse)
+        updateConstructionModel();
+    params.max_budget = budget + resolve_budget;
+    solve();
+}
+
+/* The length of the best string found */
+long int ACO::getBestStringDistance() {
+    return best_string_len;
+}
+
+/* The best string found */
+long int* ACO::getBestString() {
+    return best_ant.getString();
+}
+
+/* The amount of solutions constructed so far */
+long int ACO::getBudget() {
+    return budget;
+}
+
+/* The iterations run so far */
+long int ACO::getIterations() {
+    return iterations;
+}
+
+/* Every new best solution, in the order they were found */
+std::vector<Improvement> const& ACO::getHistory() {
+    return history;
+}
+
+/* Print where the time went */
+void ACO::printProfile() {
+    std::cout << "\nProfile:\n";
+    if (params.local) {
+        long int moves = 0;
+        long int reads = 0;
+        double seconds = 0.0;
+        for (int i = 0; i < params.n_ants; i++) {
+            moves += colony[i].getLocalSearchMoves();
+            reads += colony[i].getLocalSearchReads();
+            seconds += colony[i].getLocalSearchSeconds();
+        }
+        std::cout << "  local search (" << (params.ls_engine == LS_GAIN ? "gain" : "sweep") << "): "
+        << moves << " moves, " << reads << " letters read in " << seconds << " s";
+        if (seconds > 0)
+            std::cout << " (" << (double) moves / seconds << " moves/s)";
+        std::cout << "\n";
+        if (params.adaptive)
+            std::cout << "  adaptive: " << adaptations << " changes, local search on "
+            << ls_share * 100.0 << "% of the ants at depth " << b_rep << "\n";
+    }
+    long int delta = 0;
+    for (int i = 0; i < params.n_ants; i++) {
+        delta += colony[i].getDeltaEvaluations();
+    }
+    std::cout << "  delta evaluation: " << delta << " of " << budget
+    << " from the best string's distances\n";
+    if (sparse_pheromone != NULL) {
+        long int cells = csp->getAlphabetSize() * csp->getStringSize();
+        std::cout << "  sparse pheromone: " << sparse_pheromone->getStoredCells() << " of " << cells
+        << " cells stored, probability: " << sparse_probability->getStoredCells() << "\n";
+    }
+    if (archive != NULL) {
+        std::cout << "  archive: " << archive->size() << " solutions, " << archive->getEvaluations()
+        << " evaluations of offered solutions, " << relinks << " relinking rounds, "
+        << relink_improvements << " new best strings\n";
+    }
+    if (cache != NULL) {
+        std::cout << "  cache: " << cache->getHits() << " hits in " << cache->getLookups() << " lookups";
+        if (cache->getLookups() > 0)
+            std::cout << " (" << 100.0 * cache->getHits() / cache->getLookups() << "%)";
+        std::cout << ", " << free_hits << " not counted in the budget\n";
+    }
+    if (cutoff) {
+        std::cout << "  cutoff evaluation: " << cut_evaluations << " of " << budget
+        << " stopped at the cutoff\n";
+    }
+    std::cout << std::endl;
+}
@@ -0,0 +1,198 @@
+//
+//  aco.hpp
+//  ACO-CSP
+//
+
+#ifndef aco_hpp
+#define aco_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "ant.hpp"
+#include "csp.hpp"
+#include "cache.hpp"
+#include "archive.hpp"
+
+/* Parameters of one ACO run */
+struct Parameters {
+    bool as;                 /* Flag to indicate whether to use Ant System */
+    bool mmas;               /* Flag to indicate whether to use Min Max Ant System */
+    bool acs;                /* Flag to indicate whether to use Ant Colony System */
+    long int max_budget;     /* The max amount of solutions constructed by the ants */
+    double alpha;
+    double beta;
+    double rho;
+    long int n_ants;
+    long int seed;
+    RngKind rng;             /* Random number generator */
+    double q0;
+
+    bool local;              /* Flag to indicate whether to use local search */
+    double b_rep;            /* Local search parameter */
+    long int ls_threads;     /* Threads used to evaluate flips in local search */
+    LocalSearchEngine ls_engine; /* Local search engine: sweep or gain table */
+
+    bool dynamic_heuristic;  /* Flag to weigh the heuristic information by the distance of every string to the best */
+    bool adaptive;           /* Flag to shift effort between construction and local search as the run goes */
+
+    bool sparse;             /* Flag to construct solutions from the per-position most likely letters */
+    long int cache_size;     /* Slots of the cache of evaluated solutions, 0 for no cache */
+    bool free_hits;          /* Flag to not count solutions found in the cache against the budget */
+
+    long int archive_size;   /* Solutions in the elite archive, 0 for no archive */
+    long int relink;         /* Iterations without a new best string before path relinking */
+
+    bool sparse_pheromone;   /* Flag to store only the pheromone and probability that differ per position */
+    bool pipeline;           /* Flag to update pheromone on a thread while the next iteration builds */
+    bool stale;              /* Flag to let the next iteration build from the previous probability */
+
+    bool copy_best;          /* Flag to deposit on a copy of the best string, instead of on the ant that found it */
+
+    bool trace;              /* Flag to print budget:quality for every new best solution */
+    bool verbose;            /* Flag to indicate whether to print lots of info */
+};
+
+/* A new best solution, found after budget evaluations and seconds of wall time */
+struct Improvement {
+    long int budget;
+    double seconds;
+    long int quality;
+};
+
+/* One ACO run on a CSP instance. The instance is only read, so several runs can share it */
+class ACO {
+
+    Parameters params;
+    CSP* csp;
+    Rng* rng;
+
+    /* Probabilistic rule related variables */
+    double** pheromone;      /* pheromone matrix */
+    double** heuristic;      /* heuristic information matrix */
+    double** probability;    /* combined value of pheromone X heuristic information */
+    double** probability_next; /* probability being computed, while ants read the previous one */
+    double initial_pheromone;
+    double tau_max;
+    double tau_min;
+    std::vector<long int> string_weight;   /* weight of every string in the dynamic heuristic */
+    std::vector<long int> weighted_counts; /* weighted_counts[j*m+i]: summed weight of the strings with
+                                              letter i at position j */
+    SparseMatrix* sparse_pheromone;  /* pheromone, when stored sparse */
+    SparseMatrix* sparse_probability; /* probability, when stored sparse */
+    std::vector<unsigned char> local_letters; /* letters of the ants since the last sparse update,
+                                                 for the local rule of ACS */
+
+    long int budget;         /* The current amount of solutions constructed */
+    long int iterations;     /* The iterations run */
+    long int solve_budget;   /* The budget of the first solve, also the most free cache hits */
+    double start_time;
+
+    std::thread updater;     /* pheromone update of the last iteration, when pipelined */
+    std::atomic<long int> ready_positions; /* positions the pipelined update has finished */
+    long int update_block;   /* positions the pipelined update finishes at a time */
+    std::vector<Ant> update_ants; /* copies of the ants that deposit in the pipelined update */
+    Ant update_best;
+
+    std::vector<Ant> colony;
+    Ant best_ant;
+    long int best_source;    /* Ant of the colony that found the best string, or -1 */
+    Ant deposit_ant;         /* The string MMAS and ACS deposit on, with the best distance */
+    long int best_string_len;     /* length of the best string found */
+    std::vector<Improvement> history;
+
+    bool cutoff;             /* Flag to stop evaluations once an ant cannot improve the best */
+    long int* eval_order;    /* Strings in the order evaluations scan them, most often worst first */
+    long int* worst_hits;    /* How often every string decided an evaluation */
+    long int cut_evaluations; /* Evaluations stopped at the cutoff */
+
+    SolutionCache* cache;    /* Evaluated solutions, or NULL */
+    long int free_hits;      /* Cache hits that did not count against the budget */
+
+    EliteArchive* archive;   /* Good and diverse solutions to relink, or NULL */
+    long int stagnation;     /* Iterations since the last new best string */
+    long int relinks;        /* Path relinking rounds */
+    long int relink_improvements; /* New best strings found by path relinking */
+
+    ConstructionModel model; /* Most likely letters and deviation probabilities, for sparse construction */
+
+    /* Effort of local search, adapted to the improvement per second of construction and local
+       search with the adaptive flag (see adaptEffort) */
+    double ls_share;         /* fraction of the ants that get local search */
+    double ls_credit;        /* share accumulated since the last ant that got local search */
+    double b_rep;            /* depth of local search */
+    double construct_gain;   /* decayed improvement of the best string by construction */
+    double construct_seconds; /* decayed seconds of construction */
+    double ls_gain;          /* decayed improvement of the best string by local search */
+    double ls_seconds;       /* decayed CPU-seconds of local search */
+    long int adaptations;    /* changes of the effort */
+
+    long int* best_distances; /* Distance of the best string to every string in the set: ants are
+                                 evaluated from it, and it is updated when the set changes */
+
+    void createColony();
+    void initializeParameters();
+    void initializePheromone();
+    void initializeHeuristic();
+    void updateHeuristic();
+    void weighHeuristic(bool rebuild);
+    void initializeProbability();
+    void calculateProbability();
+    void calculateProbability(double** prob, long int begin, long int end);
+    void updateConstructionModel();
+    void boundPheromone(long int i, long int j);
+    void evaporatePheromone(long int begin, long int end);
+    void evaporatePheromone(Ant& best_ant);
+    void addPheromone(long int i, long int j, double delta);
+    void depositPheromone(std::vector<Ant>& ants, long int begin, long int end);
+    void depositPheromone(Ant& best_ant, long int begin, long int end);
+    void initializeSparse();
+    void calculateSparseProbability();
+    void updateSparsePheromone();
+    void localSparseUpdate(Ant& ant);
+    void updatePheromone(std::vector<Ant>& ants, Ant& best, double** prob, long int begin, long int end);
+    Ant& depositingAnt();
+    void startUpdate();
+    void finishUpdate();
+    void updateBestDistances();
+    void resetEvaluationOrder();
+    void updateEvaluationOrder();
+    void recordImprovement();
+    void relinkArchive();
+    bool localSearchTurn();
+    void adaptEffort();
+
+public:
+    ACO(CSP* csp_arg, Parameters const& params_arg);
+    ~ACO();
+
+    /* Run iterations until the budget is spent */
+    void solve();
+    /* Run one iteration: every ant builds (and improves) a solution, then pheromone is updated */
+    void iterate();
+    /* Whether the budget is spent */
+    bool terminationCondition();
+    /* Let solve() run until max_budget solutions are constructed in total */
+    void setBudget(long int max_budget);
+    void setLocalSearchThreads(long int threads);
+
+    /* Change the string set of the instance */
+    void addString(const char* string);
+    void removeString(long int i);
+    /* Re-solve for another budget solutions from the current pheromone, after changes to the set */
+    void resolve(long int budget);
+
+    long int getBestStringDistance();
+    long int* getBestString();
+    long int getBudget();
+    long int getIterations();
+    std::vector<Improvement> const& getHistory();
+
+    void printProfile();
+    void printPheromone();
+    void printProbability();
+};
+
+#endif /* aco_hpp */
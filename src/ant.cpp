@@ -11,56 +11,123 @@
 #include <math.h>
 #include <limits.h>
 #include <string.h>
+#include <algorithm>
+#include <vector>
+#include <thread>
 
 #include "ant.hpp"
 #include "utils.hpp"
 
-Ant::Ant() {}
+Ant::Ant() {
+    string = NULL;
+    sparse_probability = NULL;
+    ready_positions = NULL;
+    selection_prob = NULL;
+    reference = NULL;
+    ref_distances = NULL;
+    delta_evaluations = 0;
+    exact_distances = false;
+    cache = NULL;
+    cache_hit = false;
+    string_hash = 0;
+    string_distance = LONG_MAX;
+}
 
 /* Constructor */
-Ant::Ant(CSP* csp_arg, double** prob_info, long int *pseed) {
-    seed = pseed;
+Ant::Ant(CSP* csp_arg, double** prob_info, Rng *rng_arg) {
+    rng = rng_arg;
     csp = csp_arg;
     m = csp->getAlphabetSize();
     l = csp->getStringSize();
     n = csp->getSetSize();
     probability = prob_info;
+    sparse_probability = NULL;
+    ready_positions = NULL;
     selection_prob = new double[m];
     string = new long int[l];
     string_distance = LONG_MAX;
     string_length = 0;
+    cutoff = LONG_MAX;
+    eval_order = NULL;
+    worst_string = 0;
+    reference = NULL;
+    ref_distances = NULL;
+    delta_evaluations = 0;
+    exact_distances = false;
+    cache = NULL;
+    cache_hit = false;
+    string_hash = 0;
     acs = false;
+    ls_engine = LS_SWEEP;
+    ls_threads = 1;
+    ls_moves = 0;
+    ls_reads = 0;
+    ls_seconds = 0.0;
 }
 
-Ant::Ant(CSP* csp_arg, double** prob_info, long int *pseed, double q) {
-    seed = pseed;
+Ant::Ant(CSP* csp_arg, double** prob_info, Rng *rng_arg, double q) {
+    rng = rng_arg;
     csp = csp_arg;
     m = csp->getAlphabetSize();
     l = csp->getStringSize();
     n = csp->getSetSize();
     probability = prob_info;
+    sparse_probability = NULL;
+    ready_positions = NULL;
     selection_prob = new double[m];
     string = new long int[l];
     string_distance = LONG_MAX;
     string_length = 0;
+    cutoff = LONG_MAX;
+    eval_order = NULL;
+    worst_string = 0;
+    reference = NULL;
+    ref_distances = NULL;
+    delta_evaluations = 0;
+    exact_distances = false;
+    cache = NULL;
+    cache_hit = false;
+    string_hash = 0;
     acs = true;
     q0 = q;
+    ls_engine = LS_SWEEP;
+    ls_threads = 1;
+    ls_moves = 0;
+    ls_reads = 0;
+    ls_seconds = 0.0;
 }
 
 ///* Copy constructor */
 Ant::Ant(Ant const& other) {
-    seed = other.seed;
+    rng = other.rng;
     csp = other.csp;
     m = other.m;
     l = other.l;
     n = other.n;
     probability = other.probability;
+    sparse_probability = other.sparse_probability;
+    ready_positions = other.ready_positions;
     selection_prob = new double[m];
     string = new long int[l];
     string_distance = other.string_distance;
     string_length = 0;
     acs = other.acs;
     q0 = other.q0;
+    cutoff = other.cutoff;
+    eval_order = other.eval_order;
+    worst_string = other.worst_string;
+    reference = other.reference;
+    ref_distances = other.ref_distances;
+    delta_evaluations = other.delta_evaluations;
+    exact_distances = false;
+    cache = other.cache;
+    cache_hit = other.cache_hit;
+    string_hash = other.string_hash;
+    ls_engine = other.ls_engine;
+    ls_threads = other.ls_threads;
+    ls_moves = other.ls_moves;
+    ls_reads = other.ls_reads;
+    ls_seconds = other.ls_seconds;
     for (int i = 0; i < l; i++) {
         string[i] = other.string[i];
     }
@@ -69,6 +136,49 @@ Ant::Ant(Ant const& other) {
     }
 }
 
+/* Copy assignment: copies the solution, so it stays valid when the other ant searches again */
+Ant& Ant::operator=(Ant const& other) {
+    if (this == &other) return *this;
+    if (string == NULL || l != other.l || m != other.m) {
+        delete [] string;
+        delete [] selection_prob;
+        string = new long int[other.l];
+        selection_prob = new double[other.m];
+    }
+    rng = other.rng;
+    csp = other.csp;
+    m = other.m;
+    l = other.l;
+    n = other.n;
+    probability = other.probability;
+    sparse_probability = other.sparse_probability;
+    ready_positions = other.ready_positions;
+    string_distance = other.string_distance;
+    string_length = 0;
+    acs = other.acs;
+    q0 = other.q0;
+    cutoff = other.cutoff;
+    eval_order = other.eval_order;
+    worst_string = other.worst_string;
+    reference = other.reference;
+    ref_distances = other.ref_distances;
+    delta_evaluations = other.delta_evaluations;
+    exact_distances = false;
+    cache = other.cache;
+    cache_hit = other.cache_hit;
+    string_hash = other.string_hash;
+    ls_engine = other.ls_engine;
+    ls_threads = other.ls_threads;
+    ls_moves = other.ls_moves;
+    ls_reads = other.ls_reads;
+    ls_seconds = other.ls_seconds;
+    move(other.string, string, l);
+    for (int i = 0; i < m; i++) {
+        selection_prob[i] = other.selection_prob[i];
+    }
+    return *this;
+}
+
 /* Destructor */
 Ant::~Ant() {}
 
@@ -84,30 +194,97 @@ void Ant::Search() {
     // Clear the current solution
     clearString();
     
+    // Without ACS every letter takes exactly one random number, so they are drawn at once
+    if (!acs) {
+        uniforms.resize(l);
+        rng->fill(uniforms.data(), l);
+    }
     // Select first letter at random
-    string[0] = (long int) (ran01(seed) * (double) m);
+    string[0] = (long int) ((acs ? rng->next() : uniforms[0]) * (double) m);
     string_length++;
-    // Select each letter
+    // Select each letter, once its probability is final
+    long int ready = (ready_positions == NULL) ? l : 0;
     for (int i = 1; i < l; i++) {
+        if (i >= ready)
+            ready = waitForPositions(i);
         if (acs) {
-            double choice = ran01(seed);
+            double choice = rng->next();
             if (choice < q0) {
                 // Exploitation
                 string[i] = getProbLetter();
             } else {
                 // Biased Exploration
-                string[i] = getNextLetter();
+                string[i] = getNextLetter(rng->next());
             }
         } else {
-            string[i] = getNextLetter();
+            string[i] = getNextLetter(uniforms[i]);
         }
         string_length++;
     }
     // Compute the quality of the string
-    computeStringDistance();
+    if (cache != NULL)
+        string_hash = cache->hash(string);
+    if (!lookupCache())
+        computeStringDistance();
     // printString();
 }
 
+/* Construct a solution from the mode string. Deviating positions are found by geometric skips
+   with the bound of their block, and every candidate is kept with probability deviation/bound.
+   The positions that changed are evaluated from the distances of the mode string */
+void Ant::SparseSearch(ConstructionModel const& model) {
+    move(model.mode, string, l);
+    changed.clear();
+    
+    // Select first letter at random
+    string[0] = (long int) (rng->next() * (double) m);
+    if (string[0] != model.mode[0])
+        changed.push_back(0);
+    for (long int b = 0; b * model.block < l; b++) {
+        double bound = model.block_bound[b];
+        if (bound <= 0.0)
+            continue;
+        long int j = std::max(b * model.block, 1L);
+        long int end = std::min((b + 1) * model.block, l);
+        double log_keep = log(1.0 - bound);
+        while (true) {
+            if (bound < 1.0)
+                j += (long int) (log(rng->next()) / log_keep);
+            if (j >= end)
+                break;
+            if (rng->next() * bound < model.deviation[j]) {
+                string[j] = getResidualLetter(j, model.mode[j]);
+                changed.push_back(j);
+            }
+            j++;
+        }
+    }
+    string_length = l;
+    
+    // Compute the quality of the string. The hash is rolled from that of the mode string
+    if (cache != NULL) {
+        string_hash = model.mode_hash;
+        for (size_t c = 0; c < changed.size(); c++) {
+            string_hash = cache->rehash(string_hash, changed[c], model.mode[changed[c]], string[changed[c]]);
+        }
+    }
+    if (lookupCache()) {
+        return;
+    } else if ((long int) changed.size() <= l / 4) {
+        n = csp->getSetSize();
+        distances.resize(n);
+        string_distance = csp->getDistance(string, model.mode, model.mode_distances, changed.data(),
+                                           changed.size(), distances.data());
+        worst_string = std::max(getMaxIdx(distances.data(), n), 0L);
+        delta_evaluations++;
+        exact_distances = true;
+        if (cache != NULL)
+            cache->insert(string, string_hash, string_distance);
+    } else {
+        computeStringDistance();
+    }
+}
+
 /* Local pheromone update rule of ACS */
 void Ant::LocalPheromoneUpdate(double** pheromone, double rho, double initial_pheromone) {
     for (int j = 0; j < l; j++) {
@@ -119,7 +296,127 @@ void Ant::LocalPheromoneUpdate(double** pheromone, double rho, double initial_ph
 
 /* Compute the distance of the string to the CSP set */
 void Ant::computeStringDistance() {
-    string_distance = csp->getDistance(string);
+    if (reference != NULL && computeDeltaDistance()) {
+        // Done from the incumbent
+    } else if (eval_order != NULL) {
+        string_distance = csp->getDistance(string, cutoff, eval_order, &worst_string);
+        exact_distances = false;
+    } else {
+        // The distances are kept, for whoever takes the solution next (see EliteArchive::insert)
+        n = csp->getSetSize();
+        long int* all = csp->getAllDistances(string);
+        distances.assign(all, all + n);
+        string_distance = (n > 0) ? *std::max_element(all, all + n) : 0;
+        exact_distances = true;
+        delete [] all;
+    }
+    if (cache != NULL)
+        cache->insert(string, string_hash, string_distance);
+}
+
+/* Take the distance of the string from the cache, when it was evaluated before */
+bool Ant::lookupCache() {
+    cache_hit = cache != NULL && cache->lookup(string, string_hash, string_distance);
+    if (cache_hit)
+        exact_distances = false;
+    return cache_hit;
+}
+
+/* Take distances and local optima of solutions seen before from the cache */
+void Ant::setCache(SolutionCache* c) {
+    cache = c;
+}
+
+/* Whether the last solution was found in the cache */
+bool Ant::isCacheHit() {
+    return cache_hit;
+}
+
+/* Compute the distance from the distances of the incumbent, when the string differs from it in at
+   most a quarter of the positions. Returns false when it differs in more, then a full evaluation
+   is cheaper */
+bool Ant::computeDeltaDistance() {
+    n = csp->getSetSize();
+    long int max_changed = l / 4;
+    changed.resize(max_changed + 1);
+    long int n_changed = 0;
+    for (long int j = 0; j < l; j++) {
+        if (string[j] != reference[j]) {
+            if (n_changed == max_changed)
+                return false;
+            changed[n_changed++] = j;
+        }
+    }
+    distances.resize(n);
+    string_distance = csp->getDistance(string, reference, ref_distances, changed.data(), n_changed,
+                                       distances.data());
+    worst_string = std::max(getMaxIdx(distances.data(), n), 0L);
+    delta_evaluations++;
+    exact_distances = true;
+    return true;
+}
+
+/* Evaluate the next solutions from the distances of an incumbent */
+void Ant::setReference(long int* ref, const long int* ref_dist) {
+    reference = ref;
+    ref_distances = ref_dist;
+}
+
+/* Evaluations done from the incumbent so far */
+long int Ant::getDeltaEvaluations() {
+    return delta_evaluations;
+}
+
+/* Wait until the probability of position j is final. Returns the positions that are final */
+long int Ant::waitForPositions(long int j) {
+    long int ready = ready_positions->load(std::memory_order_acquire);
+    while (ready <= j) {
+        std::this_thread::yield();
+        ready = ready_positions->load(std::memory_order_acquire);
+    }
+    return ready;
+}
+
+/* Read the construction probabilities from another matrix */
+void Ant::setProbability(double** prob_info) {
+    probability = prob_info;
+}
+
+/* Read the construction probabilities from a sparse matrix */
+void Ant::setSparseProbability(const SparseMatrix* prob_info) {
+    sparse_probability = prob_info;
+}
+
+/* Wait in construction until the probability of a position is final */
+void Ant::setReadyPositions(const std::atomic<long int>* ready) {
+    ready_positions = ready;
+}
+
+/* Evaluate the next solutions with a cutoff, scanning the set in the given order */
+void Ant::setCutoff(long int c, long int* order) {
+    cutoff = c;
+    eval_order = order;
+}
+
+/* The string of the set that decided the last evaluation */
+long int Ant::getWorstString() {
+    return worst_string;
+}
+
+/* Set the quality of the current string */
+void Ant::setStringDistance(long int distance) {
+    string_distance = distance;
+    exact_distances = false;
+}
+
+/* Distances of the current string to the strings of the set, NULL if they are not known */
+const long int* Ant::getDistances() {
+    return exact_distances ? distances.data() : NULL;
+}
+
+/* Return the solution string */
+long int* Ant::getString() {
+    return string;
 }
 
 /* Return the quality of the current string */
@@ -138,10 +435,12 @@ void Ant::clearString() {
     string_length = 0;
 }
 
-/* Obtains the next letter to add according to the random proportional rule */
-long int Ant::getNextLetter() {
+/* Obtains the next letter to add according to the random proportional rule, for the random number u */
+long int Ant::getNextLetter(double u) {
     double sum_prob = 0.0;
     long int j = string_length;
+    if (sparse_probability != NULL)
+        return sparse_probability->sample(j, u);
     
     for (int i = 0; i < m; i++) {
         // Calculate the probabily of selecting each letter
@@ -150,7 +449,7 @@ long int Ant::getNextLetter() {
     }
     
     // Choose a letter
-    double choice = ran01(seed) * sum_prob;
+    double choice = u * sum_prob;
     long int idx = 0;
     while (choice > selection_prob[idx]) idx++;
     return(idx);
@@ -161,6 +460,8 @@ long int Ant::getProbLetter() {
     long int letter = -1;
     double letter_prob = 0.0;
     long int j = string_length;
+    if (sparse_probability != NULL)
+        return sparse_probability->argmax(j);
     
     for (long int i = 0; i < m; i++) {
         if (probability[i][j] > letter_prob) {
@@ -171,6 +472,22 @@ long int Ant::getProbLetter() {
     return letter;
 }
 
+/* Obtains the letter at position j according to the random proportional rule, given that it is
+   not the letter mode */
+long int Ant::getResidualLetter(long int j, long int mode) {
+    double sum_prob = 0.0;
+    for (int i = 0; i < m; i++) {
+        if (i != mode)
+            sum_prob = sum_prob + probability[i][j];
+        selection_prob[i] = sum_prob;
+    }
+    
+    double choice = rng->next() * sum_prob;
+    long int idx = (mode == 0) ? 1 : 0;
+    while (idx < m - 1 && (choice > selection_prob[idx] || idx == mode)) idx++;
+    return(idx);
+}
+
 /* Get the letter in position i of the string */
 long int Ant::getLetter(long int i) {
     return(string[i]);
@@ -184,63 +501,395 @@ void Ant::printString() {
     
 }
 
+/* Set the number of threads used to evaluate candidate flips in local search */
+void Ant::setLocalSearchThreads(long int threads) {
+    ls_threads = threads;
+}
+
+/* Select the local search engine */
+void Ant::setLocalSearchEngine(LocalSearchEngine engine) {
+    ls_engine = engine;
+}
+
+/* Accepted local search moves so far */
+long int Ant::getLocalSearchMoves() {
+    return ls_moves;
+}
+
+/* Letters of the strings read by local search so far: every distance a search computes or
+   updates for one position reads the letter of one string */
+long int Ant::getLocalSearchReads() {
+    return ls_reads;
+}
+
+/* Time spent in local search so far */
+double Ant::getLocalSearchSeconds() {
+    return ls_seconds;
+}
+
+/* Distances to all n strings when a position with column col and weight w changes from letter from
+   to letter to. Writes the new distances in out and returns the max distance over all strings
+   except skip. Branch-free so it vectorises. */
+static inline long int flipDistances(const unsigned char* col, long int n, long int w,
+                                     unsigned char from, unsigned char to, long int skip,
+                                     const long int* dist, long int* out) {
+    long int max = -1;
+    for (long int k = 0; k < n; k++) {
+        long int d = dist[k] + w * ((long int) (col[k] == from) - (long int) (col[k] == to));
+        out[k] = d;
+        long int v = (k == skip) ? -1 : d;
+        max = (v > max) ? v : max;
+    }
+    return max;
+}
+
 /* Local Search on the current solution. */
 void Ant::LocalSearch(double b_rep) {
+    double start = wallTime();
+    // The set can change between calls (see CSP::addString)
+    n = csp->getSetSize();
+    // Only the sweep keeps the distances of the string it ends with
+    exact_distances = false;
+    if (cache != NULL) {
+        // The search is deterministic, so the optimum found from a solution seen before at this
+        // depth is known
+        if (cache_hit && cache->lookupOptimum(string, string_hash, b_rep, string, string_distance))
+            return;
+        constructed.assign(string, string + l);
+    }
+    if (ls_engine == LS_GAIN) {
+        GainSearch(b_rep);
+    } else {
+        SweepSearch(b_rep);
+    }
+    if (cache != NULL)
+        cache->insertOptimum(constructed.data(), string_hash, b_rep, string, string_distance);
+    ls_seconds += wallTime() - start;
+}
+
+/* First-improvement local search: sweep over the string and take the letter of the string
+   furthest away wherever this does not increase the distance to the others. */
+void Ant::SweepSearch(double b_rep) {
     // Initialize distance arrays
     long int* dist = csp->getAllDistances(string);
-    long int* dist_cpy = new long int[n];
-    move(dist, dist_cpy, n);
-    // Initialize the loop counter N, the current max distance
-    // and the string representation of the current solution
-    int N = (int) (l * m * b_rep);
+    ls_reads += n * l;
+    long int* dist_new = new long int[n];
+    // Initialize the loop counter N and the current max distance.
+    // The string length is that of the full instance when this one is reduced
+    long int L = csp->getTotalWeight();
+    int N = (int) (L * m * b_rep);
+    int N_reset = (int) ((L * m * b_rep) / 3.0);
     long int max_dist = string_distance;
-    char* sol_string = csp->solution2string(string);
     // Start local search
     do {
         N -= 1;
         long int max_idx = getMaxIdx(dist, n);
-        for (int j = 0; j < l; j++) {
-            if (!csp->sameLetters(sol_string, max_idx, j)) {
-                long int max = -1;
-                for (int k = 0; k < n; k++) {
-                    if (k != max_idx) {
-                        if (csp->sameLetters(sol_string, k, j)
-                            && !csp->sameLetters(max_idx, k, j)) {
-                            dist[k] += 1;
-                        } else if (!csp->sameLetters(sol_string, k, j)
-                                   && csp->sameLetters(max_idx, k, j)) {
-                            dist[k] -= 1;
-                        }
-                        if (max < dist[k]) {
-                            max = dist[k];
-                        }
-                    }
-                }
+        if (max_idx < 0) {
+            // Distance 0 to every string, nothing left to improve
+            break;
+        }
+        if (ls_threads > 1) {
+            sweepParallel(max_idx, dist, dist_new, max_dist, N, N_reset);
+            continue;
+        }
+        for (long int j = 0; j < l; j++) {
+            const unsigned char* col = csp->getColumn(j);
+            unsigned char target = col[max_idx];
+            if (string[j] != target) {
+                // Try the letter of the string furthest away, and check
+                // the max distance to the other strings
+                long int max = flipDistances(col, n, csp->getWeight(j), (unsigned char) string[j], target, max_idx, dist, dist_new);
+                ls_reads += n;
                 if (max_dist > max) {
-                    N = (int) ((l * m * b_rep) / 3.0);
+                    N = N_reset;
                 }
                 if (max_dist >= max) {
                     max_dist = max;
-                    sol_string[j] = csp->getLetter(max_idx, j);
-                    dist[max_idx] -= 1;
-                    move(dist, dist_cpy, n);
-                } else {
-                    move(dist_cpy, dist, n);
+                    string[j] = target;
+                    std::swap(dist, dist_new);
+                    ls_moves++;
                 }
             }
         }
     } while (N > 0);
     // Finalize local search
-    long int* new_string = csp->string2solution(sol_string);
-    move(new_string, string, l);
     string_distance = max_dist;
+    distances.assign(dist, dist + n);
+    exact_distances = true;
     // Free up memory
     delete [] dist;
-    delete [] dist_cpy;
-    delete [] sol_string;
-    delete [] new_string;
+    delete [] dist_new;
+}
+
+/* One local search sweep where blocks of positions are evaluated in parallel against the
+   current distances. The flips that do not worsen the solution are then committed in order of
+   their gain, each one re-checked against the distances left by the flips committed before it. */
+void Ant::sweepParallel(long int max_idx, long int* &dist, long int* &dist_new,
+                        long int &max_dist, int &N, int N_reset) {
+    const long int block = 1024 * ls_threads;
+    std::vector<long int> gain(block);
+    std::vector<long int> order;
+    order.reserve(block);
+    for (long int b = 0; b < l; b += block) {
+        long int e = (b + block < l) ? b + block : l;
+        const long int* snapshot = dist;
+        parallelFor(b, e, ls_threads, [&](long int begin, long int end) {
+            // The loop workers live on, so every thread keeps its distance buffer between blocks
+            static thread_local std::vector<long int> scratch_buffer;
+            if ((long int) scratch_buffer.size() < n)
+                scratch_buffer.resize(n);
+            long int* scratch = scratch_buffer.data();
+            for (long int j = begin; j < end; j++) {
+                const unsigned char* col = csp->getColumn(j);
+                unsigned char target = col[max_idx];
+                if (string[j] == target) {
+                    gain[j - b] = LONG_MAX;
+                } else {
+                    gain[j - b] = flipDistances(col, n, csp->getWeight(j), (unsigned char) string[j], target, max_idx, snapshot, scratch);
+                }
+            }
+        });
+        // Candidate flips, best first
+        order.clear();
+        for (long int j = b; j < e; j++) {
+            if (gain[j - b] != LONG_MAX) ls_reads += n;
+            if (gain[j - b] <= max_dist) order.push_back(j);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](long int x, long int y) {
+            return gain[x - b] < gain[y - b];
+        });
+        for (size_t c = 0; c < order.size(); c++) {
+            long int j = order[c];
+            const unsigned char* col = csp->getColumn(j);
+            unsigned char target = col[max_idx];
+            long int max = flipDistances(col, n, csp->getWeight(j), (unsigned char) string[j], target, max_idx, dist, dist_new);
+            ls_reads += n;
+            if (max_dist > max) {
+                N = N_reset;
+            }
+            if (max_dist >= max) {
+                max_dist = max;
+                string[j] = target;
+                std::swap(dist, dist_new);
+                ls_moves++;
+            }
+        }
+    }
 }
 
+/* A candidate substitution of the gain table search */
+struct GainMove {
+    long int j;
+    long int a;
+    long int dist;
+    long int critical;
+};
 
+/* Passes over the gain table of fewer positions * letters than this stay on a single thread */
+static const long int gain_shard_cells = 1 << 17;
 
+/* The first letter other than cur with the largest count in a row of the gain table */
+static long int bestLetter(const int* row, long int m, long int cur) {
+    long int a = 0;
+    int key = -1;
+    for (long int b = 0; b < m; b++) {
+        int v = (b == cur) ? -1 : row[b];
+        a = (v > key) ? b : a;
+        key = (v > key) ? v : key;
+    }
+    return a;
+}
 
+/* Best-improvement tabu search on a gain table. For every position and letter, the table counts
+   how many of the strings at the max distance D (and at D-1) have that letter there. From these
+   counts, and for an improving move the strings at D-2 with the current letter, the new max
+   distance and the number of strings at it follow exactly for every possible substitution. Every
+   move takes the best non-tabu substitution. A string that changes level changes one count in
+   every row, so the rows are not cached: the counts of the strings that changed level are applied
+   in the same pass over the columns that finds the next move. A position where no string at D has
+   the current letter can only take a letter of one of them, so the pass only looks at those
+   letters and not at the whole row. A changed position stays tabu for a few moves, so the search
+   can walk over plateaus. Stops after l*m*b_rep moves without improvement. On a reduced instance
+   a move changes distances by the weight of its position, so the table only ranks the moves. */
+void Ant::GainSearch(double b_rep) {
+    const long int tenure = 10;
+    long int* dist = csp->getAllDistances(string);
+    ls_reads += n * l;
+    long int max_idx = getMaxIdx(dist, n);
+    long int max_dist = (max_idx < 0) ? 0 : dist[max_idx];
+    // Gain table: for position j and letter a, (number of critical strings with a at j) * base
+    // + (number of near strings with a at j), base the first power of 2 above n. Critical strings
+    // are at distance D, near ones at D-1, far ones at D-2. The table starts empty, with every
+    // string at no level, and the first pass counts them all
+    int shift = 0;
+    while ((1L << shift) <= n) shift++;
+    const int base = 1 << shift;
+    const int mask = base - 1;
+    long int* level = new long int[n];
+    int* table = new int[l * m];
+    for (long int i = 0; i < l * m; i++) table[i] = 0;
+    for (long int k = 0; k < n; k++) level[k] = -1;
+    std::vector<long int> critical;
+    std::vector<long int> far;
+    long int n_near = 0;
+    // Strings that changed level in the last move, with the change of their table counts
+    std::vector<long int> moved;
+    std::vector<int> moved_delta;
+    auto classify = [&]() {
+        critical.clear();
+        far.clear();
+        moved.clear();
+        moved_delta.clear();
+        n_near = 0;
+        for (long int k = 0; k < n; k++) {
+            long int now = max_dist - dist[k];
+            if (now == 0) critical.push_back(k);
+            if (now == 1) n_near++;
+            if (now == 2) far.push_back(k);
+            int delta = ((now == 0) ? base : 0) + ((now == 1) ? 1 : 0)
+                      - ((level[k] == 0) ? base : 0) - ((level[k] == 1) ? 1 : 0);
+            level[k] = now;
+            if (delta == 0) continue;
+            moved.push_back(k);
+            moved_delta.push_back(delta);
+        }
+    };
+    classify();
+    long int* tabu = new long int[l];
+    for (long int j = 0; j < l; j++) tabu[j] = -1;
+    // Best solution seen during the walk
+    long int* best = new long int[l];
+    move(string, best, l);
+    long int best_dist = max_dist;
+    long int best_critical = (long int) critical.size();
+    // The passes over all positions are split over the threads when that pays off
+    long int shards = (l * m >= gain_shard_cells) ? ls_threads : 1;
+    long int it = 0;
+    // Update the rows and find the best admissible substitution, the first one on ties
+    auto pass = [&](long int begin, long int end, GainMove& found, long int& reads) {
+        long int n_moved = (long int) moved.size();
+        long int n_critical = (long int) critical.size();
+        long int n_far = (long int) far.size();
+        for (long int j = begin; j < end; j++) {
+            const unsigned char* col = csp->getColumn(j);
+            int* row = table + j * m;
+            for (long int c = 0; c < n_moved; c++) {
+                row[col[moved[c]]] += moved_delta[c];
+            }
+            long int cur = string[j];
+            long int cur_c = row[cur] >> shift;
+            long int cur_n = row[cur] & mask;
+            long int new_dist, new_critical;
+            long int a = -1;
+            if (cur_c > 0) {
+                // Critical strings move further away, whatever letter is taken. The letter is only
+                // found if the move is taken
+                new_dist = max_dist + 1;
+                new_critical = cur_c;
+            } else {
+                // Take the letter shared by most critical strings, then by most near ones, the
+                // first one on ties. It is the letter of a critical string. The count and the
+                // letter are compared as one number, the count in the high bits
+                long int packed = -1;
+                for (long int c = 0; c < n_critical; c++) {
+                    long int letter = col[critical[c]];
+                    long int v = ((long int) row[letter] << 8) | (255 - letter);
+                    packed = (v > packed) ? v : packed;
+                }
+                reads += n_critical;
+                int key = (int) (packed >> 8);
+                a = 255 - (packed & 255);
+                if ((key >> shift) < n_critical) {
+                    new_dist = max_dist;
+                    new_critical = n_critical - (key >> shift) + cur_n;
+                } else if (cur_n > 0) {
+                    // All critical strings move closer, but near ones catch up
+                    new_dist = max_dist;
+                    new_critical = cur_n;
+                } else {
+                    // The far strings with the current letter rise to D-1
+                    long int far_cur = 0;
+                    for (long int f = 0; f < n_far; f++) {
+                        far_cur += (col[far[f]] == cur);
+                    }
+                    reads += n_far;
+                    new_dist = max_dist - 1;
+                    new_critical = n_critical + n_near - (key & mask) + far_cur;
+                }
+            }
+            // Aspiration: a tabu move is allowed if it improves on the best solution
+            if (tabu[j] > it && !(new_dist < best_dist
+                                  || (new_dist == best_dist && new_critical < best_critical)))
+                continue;
+            if (new_dist < found.dist || (new_dist == found.dist && new_critical < found.critical)) {
+                found.dist = new_dist;
+                found.critical = new_critical;
+                found.j = j;
+                found.a = a;
+            }
+        }
+        reads += n_moved * (end - begin);
+    };
+    
+    long int limit = (long int) (csp->getTotalWeight() * m * b_rep);
+    if (limit < 1) limit = 1;
+    long int stall = 0;
+    for (it = 0; stall < limit && max_dist > 0; it++) {
+        GainMove found = { -1, -1, LONG_MAX, LONG_MAX };
+        if (shards > 1) {
+            // Every thread takes a block of positions, the blocks are combined in order
+            std::vector<GainMove> partial(shards, found);
+            std::vector<long int> reads(shards, 0);
+            parallelFor(0, shards, shards, [&](long int first, long int last) {
+                for (long int t = first; t < last; t++) {
+                    pass(t * l / shards, (t + 1) * l / shards, partial[t], reads[t]);
+                }
+            });
+            for (long int t = 0; t < shards; t++) {
+                ls_reads += reads[t];
+                if (partial[t].dist < found.dist
+                    || (partial[t].dist == found.dist && partial[t].critical < found.critical))
+                    found = partial[t];
+            }
+        } else {
+            pass(0, l, found, ls_reads);
+        }
+        long int move_j = found.j;
+        if (move_j < 0) break;
+        long int move_a = (found.a < 0) ? bestLetter(table + move_j * m, m, string[move_j]) : found.a;
+        // Apply it
+        const unsigned char* col = csp->getColumn(move_j);
+        unsigned char from = (unsigned char) string[move_j];
+        unsigned char to = (unsigned char) move_a;
+        long int w = csp->getWeight(move_j);
+        long int new_max = 0;
+        for (long int k = 0; k < n; k++) {
+            dist[k] += w * ((long int) (col[k] == from) - (long int) (col[k] == to));
+            new_max = (dist[k] > new_max) ? dist[k] : new_max;
+        }
+        ls_reads += n;
+        string[move_j] = move_a;
+        tabu[move_j] = it + tenure;
+        ls_moves++;
+        // The table is updated for the strings that change level in the next pass
+        max_dist = new_max;
+        classify();
+        if (max_dist < best_dist || (max_dist == best_dist && (long int) critical.size() < best_critical)) {
+            move(string, best, l);
+            best_dist = max_dist;
+            best_critical = (long int) critical.size();
+            stall = 0;
+        } else {
+            stall++;
+        }
+    }
+    // Finalize local search
+    move(best, string, l);
+    string_distance = best_dist;
+    // Free up memory
+    delete [] dist;
+    delete [] level;
+    delete [] table;
+    delete [] tabu;
+    delete [] best;
+}
@@ -10,18 +10,43 @@
 #define ant_hpp
 
 #include <stdio.h>
+#include <vector>
+#include <atomic>
 
 #include "csp.hpp"
+#include "cache.hpp"
+#include "rng.hpp"
+#include "matrix.hpp"
+
+/* Local search engines */
+enum LocalSearchEngine {
+    LS_SWEEP,                 /* first-improvement sweeps towards the furthest string */
+    LS_GAIN                   /* best-improvement tabu search on a gain table */
+};
+
+/* The construction rule reduced to the most likely letter at every position and the probability
+   of another letter, shared by the ants of one iteration for sparse construction */
+struct ConstructionModel {
+    long int* mode;           /* the most likely letter at every position */
+    double* deviation;        /* probability that a position does not get its most likely letter */
+    double* block_bound;      /* max deviation probability of every block of positions */
+    long int block;           /* positions per block */
+    long int* mode_distances; /* distances of the mode string to every string in the set */
+    uint64_t mode_hash;       /* cache hash of the mode string, when there is a cache */
+};
 
 class Ant {
     
-    long* seed;               /* the random seed */
+    Rng* rng;                 /* the random number generator of the colony */
+    std::vector<double> uniforms; /* random numbers for a whole construction */
     long int* string;         /* the solution string */
     long int string_distance; /* the quality of the solution string */
     long int string_length;   /* how much of the solution has been build */
     
     double* selection_prob;   /* probability array for selecting a letter */
     double** probability;     /* pointer to colony pheromone */
+    const SparseMatrix* sparse_probability; /* the colony probability when stored sparse, or NULL */
+    const std::atomic<long int>* ready_positions; /* positions with final probability, NULL if all */
     CSP *csp;
     long int m;
     long int l;
@@ -30,29 +55,96 @@ class Ant {
     bool acs;                 /* bool to indicate ACS */
     double q0;                /* exploration probability */
     
+    long int cutoff;          /* evaluation stops once the string is no better than this */
+    long int* eval_order;     /* order in which evaluation scans the set, NULL for the set order */
+    long int worst_string;    /* string at the max distance, or the one that hit the cutoff */
+    long int* reference;      /* incumbent solution that evaluation starts from, NULL for none */
+    const long int* ref_distances; /* distances of the incumbent to every string in the set */
+    std::vector<long int> changed;   /* positions where the string differs from the incumbent */
+    std::vector<long int> distances; /* distances to every string, when exact_distances */
+    bool exact_distances;     /* whether distances holds the distances of the current string */
+    long int delta_evaluations; /* evaluations done from the incumbent, over all searches */
+    
+    SolutionCache* cache;     /* solutions evaluated before, NULL for none */
+    bool cache_hit;           /* whether the last solution was found in the cache */
+    uint64_t string_hash;     /* cache hash of the constructed solution */
+    std::vector<long int> constructed; /* the solution before local search, the key of its optimum */
+    
+    LocalSearchEngine ls_engine; /* which local search to run */
+    long int ls_threads;      /* threads used to evaluate flips in local search */
+    long int ls_moves;        /* accepted local search moves, over all calls */
+    long int ls_reads;        /* letters of the strings read by local search, over all calls */
+    double ls_seconds;        /* time spent in local search, over all calls */
+    
     void computeStringDistance();
+    bool computeDeltaDistance();
+    bool lookupCache();
     void clearString();
-    long int getNextLetter();
+    long int getNextLetter(double u);
+    long int waitForPositions(long int j);
     long int getProbLetter();
+    long int getResidualLetter(long int j, long int mode);
     void printString();
+    void SweepSearch(double b_rep);
+    void GainSearch(double b_rep);
+    void sweepParallel(long int max_idx, long int* &dist, long int* &dist_new,
+                       long int &max_dist, int &N, int N_reset);
     
 public:
     Ant();
-    Ant(CSP *csp_arg, double **prob_info, long int *pseed);
-    Ant(CSP *csp_arg, double **prob_info, long int *pseed, double q);
+    Ant(CSP *csp_arg, double **prob_info, Rng *rng_arg);
+    Ant(CSP *csp_arg, double **prob_info, Rng *rng_arg, double q);
     ~Ant();
     Ant(Ant const& other);
+    Ant& operator=(Ant const& other);
     
     void freeAnt();
     
     /* Construct a solution */
     void Search();
+    /* Construct a solution with the same distribution as Search, by drawing only the positions that
+       do not get their most likely letter */
+    void SparseSearch(ConstructionModel const& model);
     /* Returns the idx in the alphabet of the letter at position idx in the ant's solution */
     long int getLetter(long int idx);
-    /* Returns the max distance between the ant's solution string and all strings in the CSP set */
+    /* Returns the max distance between the ant's solution string and all strings in the CSP set.
+       With a cutoff, a string no better than the cutoff only gets a partial distance >= cutoff */
     long int getStringDistance();
+    /* Read the construction probabilities from another matrix */
+    void setProbability(double** prob_info);
+    void setSparseProbability(const SparseMatrix* prob_info);
+    /* Wait in construction until the probability of a position is final (NULL to not wait) */
+    void setReadyPositions(const std::atomic<long int>* ready);
+    /* Evaluate the next solutions with a cutoff (LONG_MAX for none), scanning the set in order */
+    void setCutoff(long int c, long int* order);
+    /* The string of the set that decided the last evaluation */
+    long int getWorstString();
+    /* Distances of the current string to every string in the set, or NULL when only its max
+       distance (or a bound on it) is known */
+    const long int* getDistances();
+    /* Evaluate the next solutions from the distances of an incumbent (NULL for none), visiting only
+       the positions where they differ from it */
+    void setReference(long int* ref, const long int* ref_dist);
+    /* Evaluations done from the incumbent so far */
+    long int getDeltaEvaluations();
+    /* Take distances, and local optima with local search, of solutions seen before from the cache */
+    void setCache(SolutionCache* c);
+    /* Whether the last solution was found in the cache, so it was not evaluated again */
+    bool isCacheHit();
+    /* Sets the max distance, when it is known without a full evaluation */
+    void setStringDistance(long int distance);
+    /* The solution string, as indices in the alphabet */
+    long int* getString();
     /* Local Search on the current solution */
     void LocalSearch(double b_rep);
+    /* Number of threads that evaluate blocks of candidate flips in local search */
+    void setLocalSearchThreads(long int threads);
+    /* Select the local search engine */
+    void setLocalSearchEngine(LocalSearchEngine engine);
+    /* Accepted local search moves, letters read and time spent in local search so far */
+    long int getLocalSearchMoves();
+    long int getLocalSearchReads();
+    double getLocalSearchSeconds();
     /* Local pheromone update rule of ACS */
     void LocalPheromoneUpdate(double** pheromone, double rho, double initial_pheromone);
     
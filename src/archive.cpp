@@ -0,0 +1,183 @@
+//
+//  archive.cpp
+//  ACO-CSP
+//
+
+#include <limits.h>
+#include <algorithm>
+
+#include "archive.hpp"
+
+/* Constructor */
+EliteArchive::EliteArchive(CSP* csp_arg, long int capacity_arg, long int min_distance_arg) {
+    csp = csp_arg;
+    capacity = capacity_arg;
+    min_distance = std::max(min_distance_arg, 1L);
+    evaluations = 0;
+}
+
+/* Hamming distance of two solutions, counted up to limit */
+static long int hamming(const long int* a, const long int* b, long int l, long int limit) {
+    long int d = 0;
+    for (long int j = 0; j < l && d < limit; j++) {
+        if (a[j] != b[j])
+            d++;
+    }
+    return d;
+}
+
+/* The member with the largest max distance */
+long int EliteArchive::getWorst() {
+    return std::max_element(qualities.begin(), qualities.end()) - qualities.begin();
+}
+
+/* Whether a solution whose max distance is at least bound can enter */
+bool EliteArchive::admits(long int bound) {
+    bool full = (long int) qualities.size() >= capacity;
+    return capacity > 0 && !(full && bound >= qualities[getWorst()]);
+}
+
+/* Offer a solution to the archive, evaluating it if it can enter */
+bool EliteArchive::insert(const long int* solution, long int bound) {
+    if (!admits(bound))
+        return false;
+    long int* dist = csp->getAllDistances(const_cast<long int*>(solution));
+    evaluations++;
+    bool entered = place(solution, dist);
+    delete[] dist;
+    return entered;
+}
+
+/* Offer a solution with known distances to the archive */
+bool EliteArchive::insert(const long int* solution, const long int* dist) {
+    long int n = csp->getSetSize();
+    if (!admits(*std::max_element(dist, dist + n)))
+        return false;
+    return place(solution, dist);
+}
+
+/* Put a solution with the given distances in the archive: in the slot of a member it is close to
+   and better than, in a new slot, or in that of the worst member when the archive is full */
+bool EliteArchive::place(const long int* solution, const long int* dist) {
+    long int l = csp->getStringSize();
+    long int n = csp->getSetSize();
+    bool full = (long int) qualities.size() >= capacity;
+    long int quality = *std::max_element(dist, dist + n);
+    long int slot = -1;
+    for (size_t s = 0; s < solutions.size(); s++) {
+        if (hamming(solution, solutions[s].data(), l, min_distance) < min_distance) {
+            slot = (quality < qualities[s]) ? (long int) s : -2;
+            break;
+        }
+    }
+    if (slot == -1 && full) {
+        slot = getWorst();
+        if (quality >= qualities[slot])
+            slot = -2;
+    }
+    if (slot == -2)
+        return false;
+    if (slot == -1) {
+        slot = (long int) solutions.size();
+        solutions.push_back(std::vector<long int>());
+        distances.push_back(std::vector<long int>());
+        qualities.push_back(0);
+    }
+    solutions[slot].assign(solution, solution + l);
+    distances[slot].assign(dist, dist + n);
+    qualities[slot] = quality;
+    return true;
+}
+
+/* Forget all members */
+void EliteArchive::clear() {
+    solutions.clear();
+    distances.clear();
+    qualities.clear();
+}
+
+/* Number of members */
+long int EliteArchive::size() {
+    return (long int) qualities.size();
+}
+
+/* The member with the smallest max distance */
+long int EliteArchive::getBest() {
+    return std::min_element(qualities.begin(), qualities.end()) - qualities.begin();
+}
+
+/* Member i, as indices in the alphabet */
+const long int* EliteArchive::getSolution(long int i) {
+    return solutions[i].data();
+}
+
+/* Distances of member i to the strings of the set */
+const long int* EliteArchive::getDistances(long int i) {
+    return distances[i].data();
+}
+
+/* Max distance of member i */
+long int EliteArchive::getQuality(long int i) {
+    return qualities[i];
+}
+
+/* Full evaluations of the solutions offered without their distances, none of which counts against
+   the budget */
+long int EliteArchive::getEvaluations() {
+    return evaluations;
+}
+
+/* Path relinking from start to guide */
+long int pathRelink(CSP* csp, const long int* start, const long int* start_distances,
+                    const long int* guide, long int* best, long int* best_distances) {
+    long int l = csp->getStringSize();
+    long int n = csp->getSetSize();
+    std::vector<long int> differ;
+    for (long int j = 0; j < l; j++) {
+        if (start[j] != guide[j])
+            differ.push_back(j);
+    }
+    if (differ.size() < 2)
+        return LONG_MAX;
+
+    // Order the positions by how much they change the distances of the strings furthest from start
+    long int start_max = *std::max_element(start_distances, start_distances + n);
+    std::vector<long int> score(l, 0);
+    for (size_t t = 0; t < differ.size(); t++) {
+        long int j = differ[t];
+        const unsigned char* col = csp->getColumn(j);
+        long int w = csp->getWeight(j);
+        for (long int k = 0; k < n; k++) {
+            if (start_distances[k] == start_max)
+                score[j] += w * ((long int) (col[k] == start[j]) - (long int) (col[k] == guide[j]));
+        }
+    }
+    std::stable_sort(differ.begin(), differ.end(), [&score](long int a, long int b) {
+        return score[a] < score[b];
+    });
+
+    // Walk, keeping the step with the best solution. The last step reaches guide
+    std::vector<long int> dist(start_distances, start_distances + n);
+    long int best_max = LONG_MAX;
+    long int best_step = -1;
+    for (size_t t = 0; t + 1 < differ.size(); t++) {
+        long int j = differ[t];
+        const unsigned char* col = csp->getColumn(j);
+        long int w = csp->getWeight(j);
+        long int max = 0;
+        for (long int k = 0; k < n; k++) {
+            dist[k] += w * ((long int) (col[k] == start[j]) - (long int) (col[k] == guide[j]));
+            max = std::max(max, dist[k]);
+        }
+        if (max < best_max) {
+            best_max = max;
+            best_step = (long int) t;
+            std::copy(dist.begin(), dist.end(), best_distances);
+        }
+    }
+    std::copy(start, start + l, best);
+    for (long int t = 0; t <= best_step; t++) {
+        best[differ[t]] = guide[differ[t]];
+    }
+    return best_max;
+}
@@ -0,0 +1,58 @@
+//
+//  archive.hpp
+//  ACO-CSP
+//
+
+#ifndef archive_hpp
+#define archive_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "csp.hpp"
+
+/* Bounded archive of good, diverse solutions. A solution closer than min_distance positions to a
+   member replaces it if it is better and is dropped otherwise; when the archive is full, a new
+   solution replaces the worst member if it is better */
+class EliteArchive {
+
+    CSP* csp;
+    long int capacity;
+    long int min_distance;    /* Hamming distance below which two solutions are the same */
+    std::vector< std::vector<long int> > solutions;
+    std::vector< std::vector<long int> > distances; /* distances of every member to the n strings */
+    std::vector<long int> qualities;                /* max distance of every member */
+    long int evaluations;     /* full evaluations of offered solutions */
+
+    long int getWorst();
+    bool admits(long int bound);
+    bool place(const long int* solution, const long int* dist);
+
+public:
+    EliteArchive(CSP* csp_arg, long int capacity_arg, long int min_distance_arg);
+
+    /* Offer a solution whose max distance is at least bound. It is only evaluated when it can enter.
+       Returns whether it entered */
+    bool insert(const long int* solution, long int bound);
+    /* Offer a solution with known distances to the n strings, which are not evaluated again */
+    bool insert(const long int* solution, const long int* dist);
+    /* Forget all members, after the set changed */
+    void clear();
+
+    long int size();
+    long int getBest();
+    const long int* getSolution(long int i);
+    const long int* getDistances(long int i);
+    long int getQuality(long int i);
+    long int getEvaluations();
+};
+
+/* Walk from start towards guide, taking the letter of guide at one differing position at a time,
+   and write the best solution strictly between them to best and its n distances to best_distances.
+   The positions are taken in the order in which they bring the strings furthest from start closer,
+   and every step updates the distances in O(n). Returns the max distance of best, or LONG_MAX if
+   the walk has no solution in between */
+long int pathRelink(CSP* csp, const long int* start, const long int* start_distances,
+                    const long int* guide, long int* best, long int* best_distances);
+
+#endif /* archive_hpp */
@@ -0,0 +1,138 @@
+//
+//  cache.cpp
+//  ACO-CSP
+//
+
+#include "cache.hpp"
+
+/* Constructor */
+SolutionCache::SolutionCache(long int capacity_arg, long int l_arg, bool optima_arg) {
+    capacity = capacity_arg;
+    l = l_arg;
+    power = new uint64_t[l];
+    // An odd multiplier, so every power is odd and no position is lost modulo 2^64
+    uint64_t p = 1;
+    for (long int j = 0; j < l; j++) {
+        power[j] = p;
+        p *= 0x9E3779B97F4A7C15ULL;
+    }
+    hashes = new uint64_t[capacity];
+    used = new bool[capacity];
+    keys = new unsigned char[capacity * l];
+    distances = new long int[capacity];
+    has_optimum = new bool[capacity];
+    optima = optima_arg ? new unsigned char[capacity * l] : NULL;
+    optimum_distances = new long int[capacity];
+    optimum_depths = new double[capacity];
+    lookups = 0;
+    hits = 0;
+    clear();
+}
+
+/* Destructor */
+SolutionCache::~SolutionCache() {
+    delete[] power;
+    delete[] hashes;
+    delete[] used;
+    delete[] keys;
+    delete[] distances;
+    delete[] has_optimum;
+    delete[] optima;
+    delete[] optimum_distances;
+    delete[] optimum_depths;
+}
+
+/* Hash of a solution */
+uint64_t SolutionCache::hash(long int* solution) {
+    uint64_t h = 0;
+    for (long int j = 0; j < l; j++) {
+        h += (uint64_t) (solution[j] + 1) * power[j];
+    }
+    return h;
+}
+
+/* The hash after one letter changed */
+uint64_t SolutionCache::rehash(uint64_t h, long int j, long int old_letter, long int new_letter) {
+    return h + (uint64_t) (new_letter - old_letter) * power[j];
+}
+
+/* Whether slot holds the solution */
+bool SolutionCache::matches(long int slot, uint64_t h, long int* solution) {
+    if (!used[slot] || hashes[slot] != h)
+        return false;
+    const unsigned char* key = keys + slot * l;
+    for (long int j = 0; j < l; j++) {
+        if (key[j] != (unsigned char) solution[j])
+            return false;
+    }
+    return true;
+}
+
+/* Look up the distance of a solution */
+bool SolutionCache::lookup(long int* solution, uint64_t h, long int &distance) {
+    long int slot = (long int) (h % (uint64_t) capacity);
+    lookups++;
+    if (!matches(slot, h, solution))
+        return false;
+    hits++;
+    distance = distances[slot];
+    return true;
+}
+
+/* Look up the local optimum found from a solution at depth b_rep */
+bool SolutionCache::lookupOptimum(long int* solution, uint64_t h, double b_rep, long int* optimum,
+                                  long int &optimum_distance) {
+    long int slot = (long int) (h % (uint64_t) capacity);
+    if (!matches(slot, h, solution) || !has_optimum[slot] || optimum_depths[slot] != b_rep)
+        return false;
+    const unsigned char* opt = optima + slot * l;
+    for (long int j = 0; j < l; j++) {
+        optimum[j] = opt[j];
+    }
+    optimum_distance = optimum_distances[slot];
+    return true;
+}
+
+/* Cache a solution with its distance */
+void SolutionCache::insert(long int* solution, uint64_t h, long int distance) {
+    long int slot = (long int) (h % (uint64_t) capacity);
+    unsigned char* key = keys + slot * l;
+    for (long int j = 0; j < l; j++) {
+        key[j] = (unsigned char) solution[j];
+    }
+    hashes[slot] = h;
+    used[slot] = true;
+    distances[slot] = distance;
+    has_optimum[slot] = false;
+}
+
+/* Cache the local optimum found from a solution at depth b_rep, if the solution is still cached */
+void SolutionCache::insertOptimum(long int* solution, uint64_t h, double b_rep, long int* optimum,
+                                  long int optimum_distance) {
+    long int slot = (long int) (h % (uint64_t) capacity);
+    if (optima == NULL || !matches(slot, h, solution))
+        return;
+    unsigned char* opt = optima + slot * l;
+    for (long int j = 0; j < l; j++) {
+        opt[j] = (unsigned char) optimum[j];
+    }
+    optimum_distances[slot] = optimum_distance;
+    optimum_depths[slot] = b_rep;
+    has_optimum[slot] = true;
+}
+
+/* Forget all solutions */
+void SolutionCache::clear() {
+    for (long int s = 0; s < capacity; s++) {
+        used[s] = false;
+        has_optimum[s] = false;
+    }
+}
+
+long int SolutionCache::getLookups() {
+    return lookups;
+}
+
+long int SolutionCache::getHits() {
+    return hits;
+}
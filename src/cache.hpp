@@ -0,0 +1,65 @@
+//
+//  cache.hpp
+//  ACO-CSP
+//
+
+#ifndef cache_hpp
+#define cache_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Fixed-size cache of evaluated solutions. Every slot holds one solution with its distance and,
+   with local search, the local optimum found from it at one depth. A solution goes to the slot of
+   its hash, so it replaces whatever was there. Lookups compare the whole solution, a hash match is
+   not enough, so the results are the same as without the cache */
+class SolutionCache {
+
+    long int capacity;        /* number of slots */
+    long int l;               /* length of the solutions */
+    uint64_t* power;          /* power[j]: the hash multiplier of position j */
+    uint64_t* hashes;
+    bool* used;
+    unsigned char* keys;      /* keys[s*l .. (s+1)*l): the solution in slot s */
+    long int* distances;
+    bool* has_optimum;
+    unsigned char* optima;    /* optima[s*l .. (s+1)*l): the local optimum found from slot s, or NULL */
+    long int* optimum_distances;
+    double* optimum_depths;   /* b_rep of the local search that found the optimum */
+
+    long int lookups;
+    long int hits;
+
+    bool matches(long int slot, uint64_t h, long int* solution);
+
+public:
+    /* A cache of capacity solutions of length l. Local optima are only kept with optima_arg */
+    SolutionCache(long int capacity_arg, long int l_arg, bool optima_arg);
+    ~SolutionCache();
+
+    /* Hash of a solution: the sum of (letter+1) * power[j], in O(l) */
+    uint64_t hash(long int* solution);
+    /* The hash h after the letter at position j changed from old_letter to new_letter, in O(1), so
+       it can be rolled along with a solution that changes in few positions */
+    uint64_t rehash(uint64_t h, long int j, long int old_letter, long int new_letter);
+
+    /* The calls below take the solution with its hash h, computed once per solution */
+
+    /* Whether the solution is cached. Sets its distance, and its local optimum and the distance of
+       that when known for a local search of depth b_rep (the adaptive effort changes it) */
+    bool lookup(long int* solution, uint64_t h, long int &distance);
+    bool lookupOptimum(long int* solution, uint64_t h, double b_rep, long int* optimum,
+                       long int &optimum_distance);
+    /* Cache a solution with its distance, replacing the solution in its slot */
+    void insert(long int* solution, uint64_t h, long int distance);
+    /* Cache the local optimum found from a cached solution by a local search of depth b_rep */
+    void insertOptimum(long int* solution, uint64_t h, double b_rep, long int* optimum,
+                       long int optimum_distance);
+    /* Forget all solutions, when the distances change */
+    void clear();
+
+    long int getLookups();
+    long int getHits();
+};
+
+#endif /* cache_hpp */
@@ -11,8 +11,16 @@
 #include <string>
 #include <iostream>
 #include <stdexcept>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 #include "csp.hpp"
+#include "utils.hpp"
+
+/* Full evaluations compare fewer positions * strings than this on a single thread */
+static const long int shard_cells = 1 << 18;
 
 /* Constructor */
 CSP::CSP(const char *file_name, bool verbose) {
@@ -41,10 +49,18 @@ CSP::CSP(const char *file_name, bool verbose) {
     
     // Read the set of strings
     for (int i = 0; i < n; i++) {
-        set[i] = new char[l];
+        set[i] = new char[l + 1];
         infile >> set[i];
     }
     
+    buildColumns(n);
+    eval_threads = 1;
+    weight = NULL;
+    total_weight = l;
+    source = NULL;
+    source_start = NULL;
+    source_cols = NULL;
+    
     if (verbose) {
         printf("... done\n\n");
         printParameters();
@@ -58,6 +74,126 @@ CSP::~CSP() {
         delete [] set[i];
     }
     delete [] set;
+    delete [] columns;
+    delete [] counts;
+    delete [] weight;
+    delete [] source_start;
+    delete [] source_cols;
+}
+
+/* Constructor of a reduced instance: takes ownership of the set, weights and column mapping */
+CSP::CSP(CSP *src, long int l_arg, char **set_arg, long int *weight_arg,
+         long int *start_arg, long int *cols_arg) {
+    m = src->m;
+    n = src->n;
+    l = l_arg;
+    alphabet = new char[m];
+    for (int i = 0; i < m; i++) {
+        alphabet[i] = src->alphabet[i];
+    }
+    set = set_arg;
+    buildColumns(n);
+    eval_threads = src->eval_threads;
+    weight = weight_arg;
+    total_weight = src->total_weight;
+    source = src;
+    source_start = start_arg;
+    source_cols = cols_arg;
+}
+
+/* A deep copy of the instance. All memory is allocated and written by the calling thread, so under
+   the first-touch policy it lives on the NUMA node that thread runs on */
+CSP* CSP::replicate() {
+    char** set_copy = new char * [n];
+    for (int k = 0; k < n; k++) {
+        set_copy[k] = new char[l + 1];
+        memcpy(set_copy[k], set[k], l + 1);
+    }
+    if (weight == NULL) {
+        CSP* copy = new CSP(this, l, set_copy, NULL, NULL, NULL);
+        copy->source = NULL;
+        return copy;
+    }
+    long int* weight_copy = new long int[l];
+    long int* start_copy = new long int[l + 1];
+    long int* cols_copy = new long int[source_start[l]];
+    memcpy(weight_copy, weight, l * sizeof(long int));
+    memcpy(start_copy, source_start, (l + 1) * sizeof(long int));
+    memcpy(cols_copy, source_cols, source_start[l] * sizeof(long int));
+    return new CSP(source, l, set_copy, weight_copy, start_copy, cols_copy);
+}
+
+/* Store the set column by column, with room for cap strings per column, so that all strings at
+   one position can be scanned contiguously. Also counts the letters in every column */
+void CSP::buildColumns(long int cap) {
+    capacity = cap;
+    columns = new unsigned char[l * capacity];
+    counts = new int[l * m];
+    for (int j = 0; j < l * m; j++) {
+        counts[j] = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        char* entry = set[i];
+        for (int j = 0; j < l; j++) {
+            long int idx = getLetterIdx(entry[j]);
+            columns[j * capacity + i] = (unsigned char) idx;
+            counts[j * m + idx]++;
+        }
+    }
+}
+
+/* Whether a string has the length and the letters of the instance */
+bool CSP::isValidString(const char* string) {
+    if ((long int) strlen(string) != l)
+        return false;
+    for (int j = 0; j < l; j++) {
+        if (alphabet[getLetterIdx(string[j])] != string[j])
+            return false;
+    }
+    return true;
+}
+
+/* Add a string to the set. Only the column counts of its letters change */
+long int CSP::addString(const char* string) {
+    if (!isValidString(string)) {
+        throw std::invalid_argument("Added string has the wrong length or letters outside the alphabet");
+    }
+    // Grow the set, and the columns when they are full
+    char** new_set = new char * [n + 1];
+    for (int i = 0; i < n; i++) {
+        new_set[i] = set[i];
+    }
+    new_set[n] = new char[l + 1];
+    strcpy(new_set[n], string);
+    delete [] set;
+    set = new_set;
+    n++;
+    if (n > capacity) {
+        delete [] columns;
+        delete [] counts;
+        buildColumns(2 * n);
+        return n - 1;
+    }
+    for (int j = 0; j < l; j++) {
+        long int idx = getLetterIdx(string[j]);
+        columns[j * capacity + n - 1] = (unsigned char) idx;
+        counts[j * m + idx]++;
+    }
+    return n - 1;
+}
+
+/* Remove string i from the set. The last string takes its index */
+void CSP::removeString(long int i) {
+    if (i < 0 || i >= n) {
+        throw std::invalid_argument("Removed string is not in the set");
+    }
+    for (int j = 0; j < l; j++) {
+        counts[j * m + columns[j * capacity + i]]--;
+        columns[j * capacity + i] = columns[j * capacity + n - 1];
+    }
+    delete [] set[i];
+    set[i] = set[n - 1];
+    n--;
 }
 
 void CSP::printParameters() {
@@ -83,9 +219,27 @@ long int CSP::getStringSize() {
     return l;
 }
 
+/* The string length the distances are measured on */
+long int CSP::getTotalWeight() {
+    return total_weight;
+}
+
+/* Whether the positions of this instance stand for several columns */
+bool CSP::isWeighted() {
+    return weight != NULL;
+}
+
 /* Compute the Hamming distance between two strings */
 long int CSP::hamming(char* entry, char* string) {
     long int d = 0;
+    if (weight) {
+        for (int i = 0; i < l; i++) {
+            if (entry[i] != string[i]) {
+                d += weight[i];
+            }
+        }
+        return d;
+    }
     for (int i = 0; i < l; i++) {
         if (entry[i] != string[i]) {
             d++;
@@ -94,6 +248,132 @@ long int CSP::hamming(char* entry, char* string) {
     return d;
 }
 
+/* Relabel a column: the letters get labels 0, 1, ... in the order in which they first appear
+   in the set; labels[i] is the label of letter i, or -1 if it does not appear */
+static long int relabel(const unsigned char* col, long int n, long int m, long int* labels) {
+    for (int i = 0; i < m; i++) {
+        labels[i] = -1;
+    }
+    long int distinct = 0;
+    for (int k = 0; k < n; k++) {
+        if (labels[col[k]] < 0) {
+            labels[col[k]] = distinct++;
+        }
+    }
+    return distinct;
+}
+
+/* Labels of the letters of position pos (see relabel above) */
+long int CSP::relabel(long int pos, long int* labels) {
+    return ::relabel(getColumn(pos), n, m, labels);
+}
+
+/* Kernelisation. Columns with the same letter pattern up to relabelling the alphabet are
+   interchangeable, so every class of such columns is one position of the reduced instance, whose
+   letters are the labels (see relabel). A class of w columns with d labels is split in pieces
+   whose sizes let any split of the w columns over the d labels be made of whole pieces, so the
+   optimum is kept: every piece is at most 1 + S/(d-1) columns, where S is the size of the pieces
+   before it. The last piece then fits in the largest part of any split, and the pieces before it
+   split the rest. With 2 labels the pieces are 1, 2, 4, ... Columns where all strings agree are
+   one piece: taking that letter is always optimal */
+CSP* CSP::reduce() {
+    std::unordered_map<std::string, long int> classes;
+    std::vector< std::vector<long int> > members;
+    std::vector<std::string> patterns;
+    std::vector<long int> distinct;
+    long int* labels = new long int[m];
+    std::string pattern(n, ' ');
+    for (long int j = 0; j < l; j++) {
+        const unsigned char* col = getColumn(j);
+        long int d = ::relabel(col, n, m, labels);
+        for (int k = 0; k < n; k++) {
+            pattern[k] = alphabet[labels[col[k]]];
+        }
+        std::unordered_map<std::string, long int>::iterator it = classes.find(pattern);
+        if (it == classes.end()) {
+            classes[pattern] = (long int) members.size();
+            members.push_back(std::vector<long int>(1, j));
+            patterns.push_back(pattern);
+            distinct.push_back(d);
+        } else {
+            members[it->second].push_back(j);
+        }
+    }
+    delete [] labels;
+    // Split the classes in weighted positions
+    std::vector<long int> weights;
+    std::vector<long int> starts;
+    std::vector<long int> cols;
+    std::vector<long int> position_class;
+    for (size_t c = 0; c < members.size(); c++) {
+        long int w = (long int) members[c].size();
+        long int done = 0;
+        while (done < w) {
+            long int piece = (distinct[c] > 1) ? 1 + done / (distinct[c] - 1) : w;
+            long int take = (piece < w - done) ? piece : w - done;
+            starts.push_back((long int) cols.size());
+            for (long int t = 0; t < take; t++) {
+                cols.push_back(members[c][done + t]);
+            }
+            weights.push_back(take);
+            position_class.push_back((long int) c);
+            done += take;
+        }
+    }
+    starts.push_back((long int) cols.size());
+    // Build the reduced instance
+    long int l_red = (long int) weights.size();
+    char** set_red = new char * [n];
+    for (int k = 0; k < n; k++) {
+        set_red[k] = new char[l_red + 1];
+        for (long int p = 0; p < l_red; p++) {
+            set_red[k][p] = patterns[position_class[p]][k];
+        }
+        set_red[k][l_red] = '\0';
+    }
+    long int* weight_red = new long int[l_red];
+    long int* start_red = new long int[l_red + 1];
+    long int* cols_red = new long int[cols.size()];
+    for (long int p = 0; p < l_red; p++) {
+        weight_red[p] = weights[p];
+    }
+    for (long int p = 0; p <= l_red; p++) {
+        start_red[p] = starts[p];
+    }
+    for (size_t c = 0; c < cols.size(); c++) {
+        cols_red[c] = cols[c];
+    }
+    return new CSP(this, l_red, set_red, weight_red, start_red, cols_red);
+}
+
+/* Map a solution of a reduced instance back to its source. Label a of a column becomes the letter
+   with that label there; labels past the letters of the column become letters it does not have */
+long int* CSP::expand(long int* solution) {
+    long int L = source->l;
+    long int* full = new long int[L];
+    long int* labels = new long int[m];
+    for (long int p = 0; p < l; p++) {
+        for (long int c = source_start[p]; c < source_start[p + 1]; c++) {
+            long int j = source_cols[c];
+            long int d = ::relabel(source->getColumn(j), n, m, labels);
+            long int letter = -1;
+            long int absent = d;
+            for (int i = 0; i < m; i++) {
+                if (labels[i] == solution[p]) {
+                    letter = i;
+                } else if (labels[i] < 0 && absent <= solution[p]) {
+                    // Absent letters take the labels d, d+1, ...; the last one takes the rest
+                    letter = i;
+                    absent++;
+                }
+            }
+            full[j] = letter;
+        }
+    }
+    delete [] labels;
+    return full;
+}
+
 /* Transform a solution to an alphabet string */
 char* CSP::solution2string(long int* solution) {
     char* string = new char[l];
@@ -108,22 +388,34 @@ char* CSP::solution2string(long int* solution) {
 /* Transform an alphabet string to a solution */
 long int* CSP::string2solution(char* string) {
     long int* solution = new long int[l];
-    long int idx = 0;
     for (int i = 0; i < l; i++) {
-        char letter = string[i];
-        for (int j = 0; j < m; j++) {
-            if (letter == alphabet[j]) {
-                idx = j;
-                break;
-            }
-        }
-        solution[i] = idx;
+        solution[i] = getLetterIdx(string[i]);
     }
     return solution;
 }
 
+/* Get the idx in the alphabet of the given letter (0 if it is not in the alphabet) */
+long int CSP::getLetterIdx(char letter) {
+    for (int j = 0; j < m; j++) {
+        if (letter == alphabet[j]) {
+            return j;
+        }
+    }
+    return 0;
+}
+
 /* Compute the max Hamming distance between a given solution and the set S */
 long int CSP::getDistance(long int* solution) {    
+    if (sharded()) {
+        long int* distances = getAllDistances(solution);
+        long int max_d = 0;
+        for (int i = 0; i < n; i++) {
+            if (distances[i] > max_d)
+                max_d = distances[i];
+        }
+        delete [] distances;
+        return max_d;
+    }
     // Transform solution to alphabet string
     char* string = solution2string(solution);
     // Compute the max distance between this string
@@ -141,6 +433,88 @@ long int CSP::getDistance(long int* solution) {
     return max_d;
 }
 
+/* Split the positions of full evaluations over threads */
+void CSP::setEvaluationThreads(long int threads) {
+    eval_threads = threads;
+}
+
+/* Whether full evaluations are split over threads */
+bool CSP::sharded() {
+    return eval_threads > 1 && l * n >= shard_cells;
+}
+
+/* Add the distances over positions [begin, end) of a solution to every string, column by column */
+void CSP::addDistances(long int* solution, long int begin, long int end, long int* distances) {
+    for (long int j = begin; j < end; j++) {
+        const unsigned char* col = getColumn(j);
+        unsigned char letter = (unsigned char) solution[j];
+        long int w = getWeight(j);
+        for (long int k = 0; k < n; k++) {
+            distances[k] += w * (long int) (col[k] != letter);
+        }
+    }
+}
+
+/* Compute the max Hamming distance between a given solution and the set S, scanning the strings
+   in the given order. As soon as the partial distance to one string reaches the cutoff the
+   solution is no better than the cutoff, and that partial distance is returned. worst is set to
+   the string at the max distance, or to the one that reached the cutoff */
+long int CSP::getDistance(long int* solution, long int cutoff, long int* order, long int* worst) {
+    const long int block = 512;
+    char* string = solution2string(solution);
+    long int max_d = 0;
+    *worst = order[0];
+    for (int k = 0; k < n; k++) {
+        char* entry = set[order[k]];
+        long int d = 0;
+        for (long int b = 0; b < l && d < cutoff; b += block) {
+            long int e = (b + block < l) ? b + block : l;
+            if (weight) {
+                for (long int j = b; j < e; j++) {
+                    d += (entry[j] != string[j]) ? weight[j] : 0;
+                }
+            } else {
+                for (long int j = b; j < e; j++) {
+                    d += (entry[j] != string[j]);
+                }
+            }
+        }
+        if (d > max_d) {
+            max_d = d;
+            *worst = order[k];
+        }
+        if (d >= cutoff)
+            break;
+    }
+    delete [] string;
+    return max_d;
+}
+
+/* Compute the distances between a given solution and every string in the set, from the distances
+   of a reference solution. Only the positions where the two differ are visited, column by column */
+long int CSP::getDistance(long int* solution, long int* reference, const long int* ref_distances,
+                          const long int* changed, long int n_changed, long int* distances) {
+    for (int k = 0; k < n; k++) {
+        distances[k] = ref_distances[k];
+    }
+    for (long int c = 0; c < n_changed; c++) {
+        long int j = changed[c];
+        const unsigned char* col = getColumn(j);
+        unsigned char from = (unsigned char) reference[j];
+        unsigned char to = (unsigned char) solution[j];
+        long int w = getWeight(j);
+        for (long int k = 0; k < n; k++) {
+            distances[k] += w * ((long int) (col[k] == from) - (long int) (col[k] == to));
+        }
+    }
+    long int max_d = 0;
+    for (int k = 0; k < n; k++) {
+        if (distances[k] > max_d)
+            max_d = distances[k];
+    }
+    return max_d;
+}
+
 /* Compute the Hamming distance between a given solution and the string at index i */
 long int CSP::getDistance(long int* solution, long int i) {
     // Transform solution to alphabet string
@@ -157,6 +531,23 @@ long int CSP::getDistance(long int* solution, long int i) {
 long int* CSP::getAllDistances(long int* solution) {
     // Initialize distances array
     long int* distances = new long int[n];
+    if (sharded()) {
+        // Every thread adds up a block of positions, then the partial distances are summed
+        std::vector< std::vector<long int> > partial(eval_threads, std::vector<long int>(n, 0));
+        parallelFor(0, eval_threads, eval_threads, [&](long int first, long int last) {
+            for (long int t = first; t < last; t++) {
+                addDistances(solution, t * l / eval_threads, (t + 1) * l / eval_threads,
+                             partial[t].data());
+            }
+        });
+        for (int i = 0; i < n; i++) {
+            distances[i] = 0;
+            for (long int t = 0; t < eval_threads; t++) {
+                distances[i] += partial[t][i];
+            }
+        }
+        return distances;
+    }
     // Transform solution to alpahbet string
     char* string = solution2string(solution);
     for (int i = 0; i < n; i++) {
@@ -172,16 +563,7 @@ long int* CSP::getAllDistances(long int* solution) {
 
 /* How many strings in the set have the letter i at the position j in the string */
 long int CSP::getCount(long int i, long int j) {
-    char letter = alphabet[i];
-    
-    long int count = 0;
-    for (int i = 0; i < n; i++) {
-        char* string = set[i];
-        if (string[j] == letter) {
-            count++;
-        }
-    }
-    return count;
+    return counts[j * m + i];
 }
 
 /* Compare if the given string has the same letter as string j from the set, on position pos */
@@ -18,9 +18,25 @@ class CSP {
     long int l;
     char *alphabet;
     char **set;
+    unsigned char *columns;   /* column-major copy of the set as alphabet indices */
+    long int capacity;        /* number of strings each column has room for */
+    int *counts;              /* counts[j*m+i]: how many strings have letter i at position j */
+    long int eval_threads;    /* threads a full evaluation splits the positions over */
+    
+    /* Reduced instances only (see reduce) */
+    long int *weight;         /* number of columns of the source each position stands for */
+    long int total_weight;    /* sum of the weights: the string length of the source */
+    CSP *source;              /* the instance this one was reduced from */
+    long int *source_start;   /* position p stands for source_cols[source_start[p] .. source_start[p+1]) */
+    long int *source_cols;
     
     long int hamming(char* entry, char* string);
     void printParameters();
+    void buildColumns(long int cap);
+    bool sharded();
+    void addDistances(long int* solution, long int begin, long int end, long int* distances);
+    CSP(CSP *src, long int l_arg, char **set_arg, long int *weight_arg,
+        long int *start_arg, long int *cols_arg);
     
 public:
     CSP(const char *file_name, bool verbose);
@@ -28,19 +44,51 @@ public:
     long int getAlphabetSize();  /* m: the size of the alphabet A */
     long int getSetSize();       /* n: the size of the string set S */
     long int getStringSize();    /* l: the length of each string s in S */
+    long int getTotalWeight();   /* the string length the distances are measured on (l unless reduced) */
+    bool isWeighted();
+    /* Split the positions of full evaluations over threads, on instances large enough for it */
+    void setEvaluationThreads(long int threads);
+    /* How many columns of the source position pos stands for (1 unless reduced) */
+    inline long int getWeight(long int pos) { return weight ? weight[pos] : 1; }
+    
+    /* A copy of the instance, written by the calling thread so its pages are on that thread's node */
+    CSP* replicate();
+    
+    /* Group the columns that are equal up to relabelling the alphabet into weighted positions */
+    CSP* reduce();
+    /* Map a solution of a reduced instance back to a solution of its source */
+    long int* expand(long int* solution);
+    /* Label the letters of position pos 0, 1, ... in order of first appearance in the set (-1 if
+       absent). Returns the number of labels */
+    long int relabel(long int pos, long int* labels);
     
     long int getDistance(long int* solution);
     long int getDistance(long int* solution, long int i);
+    long int getDistance(long int* solution, long int cutoff, long int* order, long int* worst);
+    /* Distances of a solution that differs from reference only at the n_changed positions in changed,
+       from the distances of reference. Writes all n distances and returns the max */
+    long int getDistance(long int* solution, long int* reference, const long int* ref_distances,
+                         const long int* changed, long int n_changed, long int* distances);
     long int* getAllDistances(long int* solution);
     
     long int getCount(long int i, long int j);
     
+    /* Whether a string has the length and the letters of the instance */
+    bool isValidString(const char* string);
+    /* Change the set: returns the index of the added string. Removing moves the last string to index i */
+    long int addString(const char* string);
+    void removeString(long int i);
+    
     char* solution2string(long int* solution);
     long int* string2solution(char* string);
     
     bool sameLetters(char* string, long int j, long int pos);
     bool sameLetters(long int i, long int j, long int pos);
     char getLetter(long int i, long int pos);
+    long int getLetterIdx(char letter);
+    
+    /* The alphabet indices of all n strings at position pos, stored contiguously */
+    inline const unsigned char* getColumn(long int pos) { return columns + pos * capacity; }
 
 };
 
@@ -0,0 +1,286 @@
+//
+//  exact.cpp
+//  ACO-CSP
+//
+
+#include <limits.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "exact.hpp"
+#include "utils.hpp"
+
+/* Constructor. Groups the columns in classes, the largest classes are searched first */
+ExactSolver::ExactSolver(CSP* csp_arg) {
+    csp = csp_arg;
+    n = csp->getSetSize();
+    l = csp->getStringSize();
+    m = csp->getAlphabetSize();
+    pairs = n * (n - 1) / 2;
+
+    std::unordered_map<std::string, long int> classes;
+    std::vector<std::string> keys;
+    std::vector<long int> column_labels(m);
+    std::string pattern(n, ' ');
+    for (long int j = 0; j < l; j++) {
+        const unsigned char* col = csp->getColumn(j);
+        long int d = csp->relabel(j, column_labels.data());
+        for (int k = 0; k < n; k++) {
+            pattern[k] = (char) column_labels[col[k]];
+        }
+        std::unordered_map<std::string, long int>::iterator it = classes.find(pattern);
+        if (it == classes.end()) {
+            classes[pattern] = (long int) members.size();
+            members.push_back(std::vector<long int>(1, j));
+            keys.push_back(pattern);
+            distinct.push_back(d);
+        } else {
+            members[it->second].push_back(j);
+        }
+    }
+    std::vector<long int> order(members.size());
+    for (size_t c = 0; c < order.size(); c++) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](long int a, long int b) {
+        return members[a].size() > members[b].size();
+    });
+    std::vector< std::vector<long int> > sorted_members(order.size());
+    std::vector<long int> sorted_distinct(order.size());
+    long int C = (long int) order.size();
+    patterns.resize(C * n);
+    for (long int c = 0; c < C; c++) {
+        sorted_members[c].swap(members[order[c]]);
+        sorted_distinct[c] = distinct[order[c]];
+        for (int k = 0; k < n; k++) {
+            patterns[c * n + k] = (unsigned char) keys[order[c]][k];
+        }
+    }
+    members.swap(sorted_members);
+    distinct.swap(sorted_distinct);
+
+    for (long int i = 0; i < n; i++) {
+        for (long int k = i + 1; k < n; k++) {
+            first.push_back(i);
+            second.push_back(k);
+        }
+    }
+    remaining.assign((C + 1) * pairs, 0);
+    for (long int c = C - 1; c >= 0; c--) {
+        long int w = (long int) members[c].size();
+        for (long int p = 0; p < pairs; p++) {
+            bool differs = patterns[c * n + first[p]] != patterns[c * n + second[p]];
+            remaining[c * pairs + p] = remaining[(c + 1) * pairs + p] + (differs ? w : 0);
+        }
+    }
+
+    for (long int c = 0; c < C; c++) {
+        class_start.push_back((long int) slot_class.size());
+        for (size_t t = 0; t < members[c].size(); t++) {
+            slot_class.push_back(c);
+            offset.push_back(t);
+        }
+    }
+    distances.assign(n, 0);
+    labels.assign(l, -1);
+    best_labels.assign(l, 0);
+    candidate.assign(l * m, 0);
+    candidate_bound.assign(l * m, 0);
+    tried.assign(l, 0);
+    candidates.assign(l, 0);
+    upper_bound = LONG_MAX;
+    lower_bound = 0;
+    nodes = 0;
+    stop_slot = -1;
+    stop_bound = 0;
+    deadline = 0.0;
+}
+
+/* Bound of the partial solution after slot s takes label */
+long int ExactSolver::bound(long int s, long int label) {
+    long int c = slot_class[s];
+    const unsigned char* pattern = &patterns[c * n];
+    long int left = (long int) members[c].size() - offset[s] - 1;
+    long int worst = 0;
+    for (int k = 0; k < n; k++) {
+        long int d = distances[k] + (pattern[k] != label ? 1 : 0);
+        if (d > worst)
+            worst = d;
+    }
+    for (long int p = 0; p < pairs; p++) {
+        long int i = first[p];
+        long int k = second[p];
+        bool differs = pattern[i] != pattern[k];
+        long int sum = distances[i] + (pattern[i] != label ? 1 : 0)
+            + distances[k] + (pattern[k] != label ? 1 : 0)
+            + remaining[(c + 1) * pairs + p] + (differs ? left : 0);
+        long int pair_bound = (sum + 1) / 2;
+        if (pair_bound > worst)
+            worst = pair_bound;
+    }
+    return worst;
+}
+
+/* Let slot s take label */
+void ExactSolver::apply(long int s, long int label) {
+    const unsigned char* pattern = &patterns[slot_class[s] * n];
+    for (int k = 0; k < n; k++) {
+        if (pattern[k] != label)
+            distances[k]++;
+    }
+    labels[s] = label;
+}
+
+/* Take the label of slot s back */
+void ExactSolver::undo(long int s) {
+    const unsigned char* pattern = &patterns[slot_class[s] * n];
+    for (int k = 0; k < n; k++) {
+        if (pattern[k] != labels[s])
+            distances[k]--;
+    }
+    labels[s] = -1;
+}
+
+/* The labels slot s can take below the upper bound, best bound first. Within a class the labels
+   do not decrease */
+void ExactSolver::generate(long int s) {
+    long int c = slot_class[s];
+    long int lowest = (offset[s] == 0) ? 0 : labels[s - 1];
+    long int* cand = &candidate[s * m];
+    long int* cand_bound = &candidate_bound[s * m];
+    long int count = 0;
+    for (long int a = lowest; a < distinct[c]; a++) {
+        long int b = bound(s, a);
+        if (b >= upper_bound)
+            continue;
+        long int i = count++;
+        while (i > 0 && cand_bound[i - 1] > b) {
+            cand[i] = cand[i - 1];
+            cand_bound[i] = cand_bound[i - 1];
+            i--;
+        }
+        cand[i] = a;
+        cand_bound[i] = b;
+    }
+    candidates[s] = count;
+    tried[s] = 0;
+}
+
+/* First upper bound: every column takes the label that keeps the largest distance smallest.
+   Sorting the labels of every class gives the same distances in the order of the search */
+void ExactSolver::greedy() {
+    for (long int s = 0; s < l; s++) {
+        const unsigned char* pattern = &patterns[slot_class[s] * n];
+        long int best = 0;
+        long int best_worst = LONG_MAX;
+        for (long int a = 0; a < distinct[slot_class[s]]; a++) {
+            long int worst = 0;
+            for (int k = 0; k < n; k++) {
+                long int d = distances[k] + (pattern[k] != a ? 1 : 0);
+                if (d > worst)
+                    worst = d;
+            }
+            if (worst < best_worst) {
+                best_worst = worst;
+                best = a;
+            }
+        }
+        apply(s, best);
+    }
+    upper_bound = *std::max_element(distances.begin(), distances.end());
+    best_labels = labels;
+    for (size_t c = 0; c < members.size(); c++) {
+        std::sort(best_labels.begin() + class_start[c],
+                  best_labels.begin() + class_start[c] + members[c].size());
+    }
+    for (long int s = l - 1; s >= 0; s--) {
+        undo(s);
+    }
+}
+
+/* Depth-first search over the slots. Stops at the deadline and keeps the slot it stopped at */
+void ExactSolver::search() {
+    long int s = 0;
+    generate(0);
+    while (s >= 0) {
+        if (labels[s] >= 0)
+            undo(s);
+        long int t = tried[s];
+        if (t == candidates[s] || candidate_bound[s * m + t] >= upper_bound) {
+            s--;
+            continue;
+        }
+        tried[s]++;
+        apply(s, candidate[s * m + t]);
+        if ((++nodes & 4095) == 0 && wallTime() > deadline) {
+            stop_slot = s;
+            stop_bound = candidate_bound[s * m + t];
+            return;
+        }
+        if (s + 1 == l) {
+            upper_bound = candidate_bound[s * m + t];
+            best_labels = labels;
+            continue;
+        }
+        s++;
+        generate(s);
+    }
+}
+
+/* Search from the greedy solution. When the search is stopped, the lower bound is the smallest
+   bound of the nodes left: the node it stopped at and the untried labels of the slots above it */
+bool ExactSolver::solve(double seconds) {
+    deadline = wallTime() + seconds;
+    greedy();
+    if (l > 0)
+        search();
+    if (stop_slot < 0) {
+        lower_bound = upper_bound;
+        return true;
+    }
+    lower_bound = std::min(upper_bound, stop_bound);
+    for (long int s = 0; s <= stop_slot; s++) {
+        for (long int t = tried[s]; t < candidates[s]; t++) {
+            lower_bound = std::min(lower_bound, candidate_bound[s * m + t]);
+        }
+    }
+    return false;
+}
+
+/* The distance of the best solution found */
+long int ExactSolver::getUpperBound() {
+    return upper_bound;
+}
+
+/* No solution is closer than this */
+long int ExactSolver::getLowerBound() {
+    return lower_bound;
+}
+
+/* Nodes of the search tree visited */
+long int ExactSolver::getNodes() {
+    return nodes;
+}
+
+/* Classes of interchangeable columns */
+long int ExactSolver::getClasses() {
+    return (long int) members.size();
+}
+
+/* The best solution: label a of a column is the letter with that label there */
+long int* ExactSolver::getBestString() {
+    long int* solution = new long int[l];
+    std::vector<long int> column_labels(m);
+    for (size_t c = 0; c < members.size(); c++) {
+        for (size_t t = 0; t < members[c].size(); t++) {
+            long int j = members[c][t];
+            csp->relabel(j, column_labels.data());
+            for (int i = 0; i < m; i++) {
+                if (column_labels[i] == best_labels[class_start[c] + t])
+                    solution[j] = i;
+            }
+        }
+    }
+    return solution;
+}
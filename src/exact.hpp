@@ -0,0 +1,77 @@
+//
+//  exact.hpp
+//  ACO-CSP
+//
+
+#ifndef exact_hpp
+#define exact_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "csp.hpp"
+
+/* Branch and bound over the columns of an instance, for small string sets. Columns that are equal
+   up to relabelling the alphabet form a class and are searched one after the other. Their columns
+   are interchangeable, so the labels taken within a class never decrease. Letters no string has
+   are never taken: any letter of the column is at least as good. Nodes are bounded by the largest
+   distance so far and, for every pair of strings, half of their summed distances plus the columns
+   left where they differ: every letter there misses at least one of the two */
+class ExactSolver {
+
+    CSP* csp;
+    long int n;
+    long int l;
+    long int pairs;                   /* n*(n-1)/2 */
+
+    /* Classes of columns */
+    std::vector<unsigned char> patterns; /* patterns[c*n+k]: label of string k in class c */
+    std::vector<long int> distinct;   /* labels of class c */
+    std::vector< std::vector<long int> > members; /* columns of class c */
+    std::vector<long int> remaining;  /* remaining[c*pairs+p]: columns of classes c, c+1, ... where
+                                         the pair p differs */
+    std::vector<long int> first;      /* first[p], second[p]: the strings of pair p */
+    std::vector<long int> second;
+
+    /* Search, with columns taken class by class: slot s is column offset[s] of class slot_class[s] */
+    std::vector<long int> slot_class;
+    std::vector<long int> offset;
+    std::vector<long int> class_start; /* first slot of class c */
+    std::vector<long int> distances;  /* distances of the partial solution */
+    std::vector<long int> labels;     /* labels of the partial solution */
+    std::vector<long int> best_labels;
+    std::vector<long int> candidate;  /* candidate[s*m+i]: i-th label tried at slot s, best bound first */
+    std::vector<long int> candidate_bound;
+    std::vector<long int> tried;      /* tried[s]: candidates of slot s started */
+    std::vector<long int> candidates; /* candidates[s]: candidates of slot s */
+    long int m;
+
+    long int upper_bound;
+    long int lower_bound;
+    long int nodes;
+    long int stop_slot;               /* slot the search stopped at, or -1 */
+    long int stop_bound;
+    double deadline;
+
+    long int bound(long int s, long int label);
+    void apply(long int s, long int label);
+    void undo(long int s);
+    void generate(long int s);
+    void greedy();
+    void search();
+
+public:
+    ExactSolver(CSP* csp_arg);
+
+    /* Search for at most seconds of wall time. Returns whether the best solution is optimal */
+    bool solve(double seconds);
+
+    long int getUpperBound();
+    long int getLowerBound();
+    long int getNodes();
+    long int getClasses();
+    /* The best solution found, as letters of the instance */
+    long int* getBestString();
+};
+
+#endif /* exact_hpp */
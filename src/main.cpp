@@ -12,77 +12,137 @@
 #include <limits.h>
 #include <string.h>
 #include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <map>
 
 #include "utils.hpp"
 #include "ant.hpp"
 #include "csp.hpp"
+#include "aco.hpp"
+#include "portfolio.hpp"
+#include "exact.hpp"
 
 
 char* instance_file=NULL;
 CSP*  csp;
+CSP*  full_csp=NULL;     /* The instance as read, when csp is its reduction */
+bool reduce;             /* Flag to indicate whether to solve the reduced instance */
 
-/* Probabilistic rule related variables */
-double** pheromone;      /* pheromone matrix */
-double** heuristic;      /* heuristic information matrix */
-double** probability;    /* combined value of pheromone X heuristic information */
-double initial_pheromone;
-
-bool as;                 /* Flag to indicate whether to use Ant System */
-long int max_budget;     /* The max amount of solutions constructed by the ants */
-long int budget=0;       /* The current amount of solutions constructed */
-double alpha;
-double beta;
-double rho;
-long int n_ants;
-long int seed = -1;
-
-bool mmas;               /* Flag to indicate whether to use Min Max Ant System */
-double tau_max;
-double tau_min;
-
-bool local;              /* Flag to indicate whether to use local search */
-double b_rep;            /* Local search parameter */
-
-bool acs;                /* Flag to indicate whether to use Ant Colony System */
-double q0;
-
+Parameters params;       /* Parameters of the ACO algorithm */
 bool verbose;            /* Flag to indicate whether to print lots of info */
 
-std::vector<Ant> colony;
-Ant best_ant;
-long int best_string_len=LONG_MAX;     /* length of the best string found */
+char* changes_file=NULL; /* Changes to the string set, applied after the first solve */
+long int resolve_budget; /* Solutions constructed in every re-solve, -1 for a quarter of the budget */
+
+std::vector<long int> targets; /* Target distances of the time-to-target mode */
+long int runs;           /* Number of runs in the time-to-target mode, or of every configuration in the portfolio */
+long int threads;        /* Number of runs at the same time */
+char* portfolio_file=NULL; /* Configurations to race, one per line */
+double exact_seconds;    /* Time limit of the exact search before the ACO, 0 for none */
+long int exact_lower_bound; /* Lower bound the exact search reached */
+long int checkpoints;    /* Racing tests of the portfolio mode */
+long int eval_threads;   /* Threads that split the positions of a full evaluation */
+bool pin;                /* Flag to pin every thread to its own CPU */
+bool numa;               /* Flag to replicate the instance on every NUMA node */
 
 /* Default parameters */
 void setDefaultParameters() {
-    as=false;
-    mmas=false;
-    acs=false;
-    local=false;
+    params.as=false;
+    params.mmas=false;
+    params.acs=false;
+    params.local=false;
     verbose=false;
-    
-    alpha=1;
-    beta=1;
-    rho=0.1;
-    n_ants=10;
-    max_budget=1000;
+
+    params.alpha=1;
+    params.beta=1;
+    params.rho=0.1;
+    params.n_ants=10;
+    params.max_budget=1000;
     instance_file=NULL;
-    seed=(long int) time(NULL);
-    b_rep=0.001;
-    q0=0.9;
+    params.seed=(long int) time(NULL);
+    params.b_rep=0.001;
+    changes_file=NULL;
+    resolve_budget=-1;
+    reduce=false;
+    params.ls_threads=1;
+    params.ls_engine=LS_SWEEP;
+    params.dynamic_heuristic=false;
+    params.adaptive=false;
+    params.sparse=false;
+    params.rng=RNG_LEGACY;
+    params.archive_size=0;
+    params.relink=5;
+    params.sparse_pheromone=false;
+    params.pipeline=false;
+    params.stale=false;
+    params.copy_best=false;
+    params.cache_size=0;
+    params.free_hits=false;
+    params.q0=0.9;
+    runs=10;
+    threads=1;
+    portfolio_file=NULL;
+    checkpoints=10;
+    exact_seconds=0;
+    exact_lower_bound=0;
+    eval_threads=1;
+    pin=false;
+    numa=false;
+}
+
+/* Name of a random number generator */
+const char* rngName(RngKind kind) {
+    switch (kind) {
+        case RNG_XOSHIRO: return "xoshiro";
+        case RNG_PCG: return "pcg";
+        case RNG_COUNTER: return "counter";
+        default: return "legacy";
+    }
 }
 
 /* Print default parameters */
 void printParameters() {
     std::cout << "\nACO parameters:\n"
-    << "  ants: "   << n_ants << "\n"
-    << "  alpha: "  << alpha << "\n"
-    << "  beta: "   << beta << "\n"
-    << "  rho: "    << rho << "\n"
-    << "  budget: " << max_budget << "\n"
-    << "  seed: "   << seed << "\n"
-    << "  local: "  << local << "\n"
-    << "  b_rep: "  << b_rep << "\n"
-    << "  q0: "     << q0 << "\n"
+    << "  ants: "   << params.n_ants << "\n"
+    << "  alpha: "  << params.alpha << "\n"
+    << "  beta: "   << params.beta << "\n"
+    << "  rho: "    << params.rho << "\n"
+    << "  budget: " << params.max_budget << "\n"
+    << "  seed: "   << params.seed << "\n"
+    << "  rng: "    << rngName(params.rng) << "\n"
+    << "  local: "  << params.local << "\n"
+    << "  b_rep: "  << params.b_rep << "\n"
+    << "  ls_threads: " << params.ls_threads << "\n"
+    << "  ls: "     << (params.ls_engine == LS_GAIN ? "gain" : "sweep") << "\n"
+    << "  dynamicheuristic: " << params.dynamic_heuristic << "\n"
+    << "  adaptive: " << params.adaptive << "\n"
+    << "  sparse: " << params.sparse << "\n"
+    << "  archive: " << params.archive_size << "\n"
+    << "  relink: "  << params.relink << "\n"
+    << "  sparsepheromone: " << params.sparse_pheromone << "\n"
+    << "  pipeline: " << params.pipeline << "\n"
+    << "  stale: "  << params.stale << "\n"
+    << "  copybest: " << params.copy_best << "\n"
+    << "  cache: "  << params.cache_size << "\n"
+    << "  freehits: " << params.free_hits << "\n"
+    << "  q0: "     << params.q0 << "\n"
+    << "  changes: " << (changes_file ? changes_file : "none") << "\n"
+    << "  resolvebudget: " << resolve_budget << "\n"
+    << "  reduce: " << reduce << "\n"
+    << "  targets: " << targets.size() << "\n"
+    << "  runs: "   << runs << "\n"
+    << "  threads: " << threads << "\n"
+    << "  portfolio: " << (portfolio_file ? portfolio_file : "none") << "\n"
+    << "  checkpoints: " << checkpoints << "\n"
+    << "  exact: "  << exact_seconds << "\n"
+    << "  evalthreads: " << eval_threads << "\n"
+    << "  pin: "    << pin << "\n"
+    << "  numa: "   << numa << "\n"
     << "  verbose: " << verbose << "\n"
     << std::endl;
 }
@@ -103,55 +163,196 @@ void printHelp() {
     << "   --rho: Rho parameter (float). Defaut=0.1.\n"
     << "   --budget: Maximum number of strings to build (integer). Default=1000.\n"
     << "   --seed: Number for the random seed generator.\n"
+    << "   --rng: Random number generator, legacy (published results), xoshiro, pcg or counter. Default=legacy.\n"
     << "   --instance: Path to the instance file\n"
     << "   --brep: Control number of Local Search steps. Default=0.001.\n"
+    << "   --ls: Local Search engine, gain (best-improvement tabu search) or sweep. Default=sweep.\n"
+    << "   --lsthreads: Threads evaluating blocks of flips in Local Search. Default=1.\n"
+    << "   --dynamicheuristic: Flag to weigh the letters of the strings furthest from the best string more in the heuristic information.\n"
+    << "   --adaptive: Flag to shift effort between construction and Local Search as the run goes.\n"
+    << "   --sparse: Flag to construct strings by drawing only the positions that differ from the most likely letters.\n"
+    << "   --archive: Number of good and diverse solutions to keep for path relinking. Default=0.\n"
+    << "   --relink: Iterations without a new best solution before path relinking in the archive. Default=5.\n"
+    << "   --sparsepheromone: Flag to store only the pheromone and probability that differ from their position's baseline.\n"
+    << "   --pipeline: Flag to update pheromone on a thread while the next iteration builds.\n"
+    << "   --stale: Flag to build from the probability of the iteration before the last (implies --pipeline).\n"
+    << "   --copybest: Flag to deposit pheromone on a copy of the best string (MMAS, ACS), not on the ant that found it.\n"
+    << "   --cache: Number of evaluated solutions to keep, to not evaluate them again. Default=0.\n"
+    << "   --freehits: Flag to not count solutions found in the cache against the budget.\n"
     << "   --q0: Probability for exploration in Ant Colony System. Default=0.9.\n"
+    << "   --reduce: Flag to solve the instance with equivalent columns grouped.\n"
+    << "   --changes: File with changes to the string set, re-solved from the current pheromone.\n"
+    << "   --resolvebudget: Maximum number of strings to build in every re-solve of the changes (integer). Default=budget/4.\n"
+    << "   --targets: Comma separated target distances. Runs the time-to-target mode.\n"
+    << "   --runs: Number of runs in the time-to-target mode, or of every configuration in the portfolio mode. Default=10.\n"
+    << "   --threads: Number of runs at the same time in the time-to-target and portfolio modes. Default=1.\n"
+    << "   --portfolio: File with configurations, one per line, to race on the instance with --runs seeds each.\n"
+    << "   --checkpoints: Number of racing tests in the portfolio mode. Default=10.\n"
+    << "   --exact: Seconds of exact search (branch and bound) before the ACO, which is skipped if it finds the optimum.\n"
+    << "   --evalthreads: Threads that split the positions of a full evaluation of a long string. Default=1.\n"
+    << "   --pin: Flag to pin every thread to its own CPU.\n"
+    << "   --numa: Flag to pin threads across NUMA nodes and replicate the instance on every node.\n"
     << "   --v: Flag to indicate verbosity of the output.\n"
     << std::endl;
 }
 
+/* Read a comma separated list of target distances */
+void readTargets(const char* list) {
+    std::istringstream in(list);
+    std::string target;
+    while (std::getline(in, target, ',')) {
+        if (!target.empty())
+            targets.push_back(atol(target.c_str()));
+    }
+}
+
+
+/* Read the algorithm flag at argv[i] into p, moving i to its value. Returns 1 if it was read, 0 if
+   argv[i] is not an algorithm flag and -1 if its value is invalid */
+int readAlgorithmArgument(char* argv[], int& i, Parameters& p) {
+    if(strcmp(argv[i], "--ants") == 0){
+        p.n_ants = atol(argv[i+1]);
+        i++;
+    } else if(strcmp(argv[i], "--alpha") == 0){
+        p.alpha = atof(argv[i+1]);
+        i++;
+    } else if(strcmp(argv[i], "--beta") == 0){
+        p.beta = atof(argv[i+1]);
+        i++;
+    } else if(strcmp(argv[i], "--rho") == 0) {
+        p.rho = atof(argv[i+1]);
+        i++;
+    } else if(strcmp(argv[i], "--as") == 0) {
+        p.as = true;
+    } else if(strcmp(argv[i], "--mmas") == 0) {
+        p.mmas = true;
+    } else if(strcmp(argv[i], "--acs") == 0) {
+        p.acs = true;
+    } else if(strcmp(argv[i], "--q0") == 0) {
+        p.q0 = atof(argv[i+1]);
+        i++;
+    } else if(strcmp(argv[i], "--local") == 0) {
+        p.local = true;
+    } else if (strcmp(argv[i], "--brep") == 0) {
+        p.b_rep = atof(argv[i+1]);
+        i++;
+    } else if (strcmp(argv[i], "--ls") == 0) {
+        if (strcmp(argv[i+1], "gain") == 0) {
+            p.ls_engine = LS_GAIN;
+        } else if (strcmp(argv[i+1], "sweep") == 0) {
+            p.ls_engine = LS_SWEEP;
+        } else {
+            std::cout << "Unknown local search " << argv[i+1] << ".\n";
+            return(-1);
+        }
+        i++;
+    } else {
+        return(0);
+    }
+    return(1);
+}
+
+/* Whether more than one algorithm is selected */
+bool multipleAlgorithms(Parameters const& p) {
+    return (p.mmas && p.acs) || (p.mmas && p.as) || (p.acs && p.as);
+}
 
 /* Read arguments from command line */
 bool readArguments(int argc, char* argv[]) {
-    
+
     setDefaultParameters();
-    
+
     for(int i=1; i< argc ; i++){
-        if(strcmp(argv[i], "--ants") == 0){
-            n_ants = atol(argv[i+1]);
+        int read = readAlgorithmArgument(argv, i, params);
+        if (read < 0)
+            return(false);
+        if (read > 0)
+            continue;
+        if(strcmp(argv[i], "--budget") == 0) {
+            params.max_budget = atol(argv[i+1]);
             i++;
-        } else if(strcmp(argv[i], "--alpha") == 0){
-            alpha = atof(argv[i+1]);
+        } else if(strcmp(argv[i], "--seed") == 0) {
+            params.seed = atol(argv[i+1]);
             i++;
-        } else if(strcmp(argv[i], "--beta") == 0){
-            beta = atof(argv[i+1]);
+        } else if (strcmp(argv[i], "--rng") == 0) {
+            if (strcmp(argv[i+1], "legacy") == 0) {
+                params.rng = RNG_LEGACY;
+            } else if (strcmp(argv[i+1], "xoshiro") == 0) {
+                params.rng = RNG_XOSHIRO;
+            } else if (strcmp(argv[i+1], "pcg") == 0) {
+                params.rng = RNG_PCG;
+            } else if (strcmp(argv[i+1], "counter") == 0) {
+                params.rng = RNG_COUNTER;
+            } else {
+                std::cout << "Unknown random number generator " << argv[i+1] << ".\n";
+                return(false);
+            }
             i++;
-        } else if(strcmp(argv[i], "--rho") == 0) {
-            rho = atof(argv[i+1]);
+        } else if(strcmp(argv[i], "--instance") == 0) {
+            instance_file = argv[i+1];
             i++;
-        } else if(strcmp(argv[i], "--budget") == 0) {
-            max_budget = atol(argv[i+1]);
+        } else if (strcmp(argv[i], "--lsthreads") == 0) {
+            params.ls_threads = atol(argv[i+1]);
             i++;
-        } else if(strcmp(argv[i], "--seed") == 0) {
-            seed = atol(argv[i+1]);
+        } else if (strcmp(argv[i], "--dynamicheuristic") == 0) {
+            params.dynamic_heuristic = true;
+        } else if (strcmp(argv[i], "--adaptive") == 0) {
+            params.adaptive = true;
+        } else if (strcmp(argv[i], "--sparse") == 0) {
+            params.sparse = true;
+        } else if (strcmp(argv[i], "--archive") == 0) {
+            params.archive_size = atol(argv[i+1]);
             i++;
-        } else if(strcmp(argv[i], "--instance") == 0) {
-            instance_file = argv[i+1];
+        } else if (strcmp(argv[i], "--relink") == 0) {
+            params.relink = atol(argv[i+1]);
             i++;
-        } else if(strcmp(argv[i], "--mmas") == 0) {
-            mmas = true;
-        } else if(strcmp(argv[i], "--local") == 0) {
-            local = true;
-        } else if (strcmp(argv[i], "--brep") == 0) {
-            b_rep = atof(argv[i+1]);
+        } else if (strcmp(argv[i], "--sparsepheromone") == 0) {
+            params.sparse_pheromone = true;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            params.pipeline = true;
+        } else if (strcmp(argv[i], "--stale") == 0) {
+            params.pipeline = true;
+            params.stale = true;
+        } else if (strcmp(argv[i], "--copybest") == 0) {
+            params.copy_best = true;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            params.cache_size = atol(argv[i+1]);
             i++;
-        } else if (strcmp(argv[i], "--acs") == 0) {
-            acs = true;
-        } else if (strcmp(argv[i], "--q0") == 0) {
-            q0 = atof(argv[i+1]);
+        } else if (strcmp(argv[i], "--freehits") == 0) {
+            params.free_hits = true;
+        } else if (strcmp(argv[i], "--reduce") == 0) {
+            reduce = true;
+        } else if (strcmp(argv[i], "--changes") == 0) {
+            changes_file = argv[i+1];
+            i++;
+        } else if (strcmp(argv[i], "--resolvebudget") == 0) {
+            resolve_budget = atol(argv[i+1]);
+            i++;
+        } else if (strcmp(argv[i], "--targets") == 0) {
+            readTargets(argv[i+1]);
+            i++;
+        } else if (strcmp(argv[i], "--runs") == 0) {
+            runs = atol(argv[i+1]);
+            i++;
+        } else if (strcmp(argv[i], "--evalthreads") == 0) {
+            eval_threads = atol(argv[i+1]);
+            i++;
+        } else if (strcmp(argv[i], "--pin") == 0) {
+            pin = true;
+        } else if (strcmp(argv[i], "--numa") == 0) {
+            numa = true;
+        } else if (strcmp(argv[i], "--portfolio") == 0) {
+            portfolio_file = argv[i+1];
+            i++;
+        } else if (strcmp(argv[i], "--exact") == 0) {
+            exact_seconds = atof(argv[i+1]);
+            i++;
+        } else if (strcmp(argv[i], "--checkpoints") == 0) {
+            checkpoints = atol(argv[i+1]);
+            i++;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atol(argv[i+1]);
             i++;
-        } else if (strcmp(argv[i], "--as") == 0) {
-            as = true;
         } else if (strcmp(argv[i], "--v") == 0) {
             verbose = true;
         } else if(strcmp(argv[i], "--help") == 0) {
@@ -166,238 +367,282 @@ bool readArguments(int argc, char* argv[]) {
         std::cout << "No instance file provided.\n";
         return(false);
     }
-    if ((mmas && acs) || (mmas && as) || (acs && as)) {
+    if (multipleAlgorithms(params)) {
         std::cout << "Cannot use multiple algorithms at the same time!\n";
         return(false);
     }
+    if (changes_file != NULL && reduce) {
+        std::cout << "Cannot change the set of a reduced instance.\n";
+        return(false);
+    }
+    if (resolve_budget < 0)
+        resolve_budget = params.max_budget / 4;
+    if (changes_file != NULL && resolve_budget < 1) {
+        std::cout << "Changes need a budget for every re-solve.\n";
+        return(false);
+    }
+    if (!targets.empty() && changes_file != NULL) {
+        std::cout << "Cannot use targets and changes at the same time!\n";
+        return(false);
+    }
+    if (portfolio_file != NULL && (!targets.empty() || changes_file != NULL)) {
+        std::cout << "Cannot race a portfolio with targets or changes.\n";
+        return(false);
+    }
+    if (threads < 1) {
+        std::cout << "At least one thread is needed.\n";
+        return(false);
+    }
+    if (portfolio_file != NULL && (params.max_budget == 0 || checkpoints < 1)) {
+        std::cout << "A portfolio needs a budget and at least one checkpoint.\n";
+        return(false);
+    }
+    if (exact_seconds > 0 && (reduce || changes_file != NULL || !targets.empty() || portfolio_file != NULL)) {
+        std::cout << "Cannot use the exact search with reduce, changes, targets or a portfolio.\n";
+        return(false);
+    }
+    if (params.archive_size > 0 && params.relink < 1) {
+        std::cout << "Path relinking needs at least 1 iteration without a new best solution.\n";
+        return(false);
+    }
+    if (params.adaptive && !params.local) {
+        std::cout << "Adaptive effort needs local search.\n";
+        return(false);
+    }
+    if (params.sparse_pheromone && params.dynamic_heuristic) {
+        std::cout << "Cannot use sparse pheromone with the dynamic heuristic, it is not stored.\n";
+        return(false);
+    }
+    if (params.sparse_pheromone && (params.sparse || params.pipeline)) {
+        std::cout << "Cannot use sparse pheromone with sparse construction or pipeline.\n";
+        return(false);
+    }
+    if (params.pipeline && params.sparse) {
+        std::cout << "Cannot use pipeline and sparse at the same time!\n";
+        return(false);
+    }
+    if (params.stale && params.acs) {
+        std::cout << "Cannot use stale probabilities with ACS, its ants update the pheromone.\n";
+        return(false);
+    }
+    params.verbose = verbose;
+    params.trace = targets.empty() && portfolio_file == NULL;
     if (verbose)
         printParameters();
     return(true);
 }
 
-void printPheromone () {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    printf("\nPheromone:\n");
-    for (int i = 0; i < m; i++) {
-        for (int j = 0; j < l; j++) {
-            printf(" %4.4lf", pheromone[i][j]);
-        }
-        printf("\n");
+/* Re-solve after a batch of changes to the string set */
+void resolve(ACO& aco, long int batch) {
+    double start = wallTime();
+    aco.resolve(resolve_budget);
+    if (verbose) {
+        std::cout << "Re-solve " << batch << ": " << csp->getSetSize() << " strings, best "
+        << aco.getBestStringDistance() << " in " << wallTime() - start << " s\n";
     }
 }
 
-void printProbability () {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    printf("\nProbability:\n");
-    for (int i = 0 ; i < m; i++) {
-        for (int j = 0 ; j < l; j++) {
-            printf(" %4.4lf ", probability[i][j]);
-        }
-        printf("\n");
+/* Apply the changes file. Every line is "+ STRING" (add a string), "- IDX" (remove the string
+   at index IDX, the last string takes its index) or "=" (re-solve). Pending changes are
+   re-solved at the end of the file */
+void applyChanges(ACO& aco) {
+    std::ifstream infile(changes_file);
+    if (!infile.is_open()) {
+        std::cerr << "Failed to open " << changes_file << '\n';
+        throw std::invalid_argument("Received an invalid changes file");
     }
-}
-
-/* Create colony structure */
-void createColony() {
-    if (verbose)
-        std::cout << "Creating colony.\n\n";
-    for (int i = 0 ; i < n_ants; i++) {
-        if (acs) {
-            colony.push_back(Ant(csp, probability, &seed, q0));
+    std::string line;
+    long int batch = 0;
+    bool pending = false;
+    while (std::getline(infile, line)) {
+        std::istringstream in(line);
+        std::string op;
+        if (!(in >> op))
+            continue;
+        if (op == "+") {
+            std::string string;
+            if (!(in >> string) || !csp->isValidString(string.c_str())) {
+                std::cerr << "Invalid addition " << line << '\n';
+                throw std::invalid_argument("Received an invalid changes file");
+            }
+            aco.addString(string.c_str());
+            pending = true;
+        } else if (op == "-") {
+            long int idx;
+            // The set keeps at least one string
+            if (!(in >> idx) || idx < 0 || idx >= csp->getSetSize() || csp->getSetSize() < 2) {
+                std::cerr << "Invalid removal " << line << '\n';
+                throw std::invalid_argument("Received an invalid changes file");
+            }
+            aco.removeString(idx);
+            pending = true;
+        } else if (op == "=") {
+            resolve(aco, ++batch);
+            pending = false;
         } else {
-            colony.push_back(Ant(csp, probability, &seed));
+            std::cerr << "Unknown change " << line << '\n';
+            throw std::invalid_argument("Received an invalid changes file");
         }
-        
-    }
-}
-
-/* Initialize parameters of the ACO algorithm */
-void initializeParameters() {
-    initial_pheromone = 1.0 / (double) csp->getAlphabetSize();
-    if (mmas) {
-        tau_max = 1.0 / (double) csp->getAlphabetSize();
-        double ratio = (double) csp->getAlphabetSize() * (double) csp->getStringSize();
-        tau_min = tau_max / ratio;
     }
+    if (pending)
+        resolve(aco, ++batch);
 }
 
-/* Initialize pheromone with an initial value */
-void initializePheromone() {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    pheromone = new double* [m];
-    for (int i = 0 ; i < m; i++) {
-        pheromone[i] = new double[l];
-        for (int j = 0; j < l; j++) {
-            if (mmas) {
-                pheromone[i][j] = tau_max;
-            } else {
-                pheromone[i][j] = initial_pheromone;
-            }
+/* Time-to-target mode. Runs the algorithm with seeds seed, seed+1, ... and records the wall time
+   and the evaluations it takes every run to reach each target. Prints the empirical run-time
+   distributions: for every target, the i-th smallest time and evaluations with probability i/runs */
+void timeToTarget() {
+    long int hardest = *std::min_element(targets.begin(), targets.end());
+    std::vector< std::vector<double> > seconds(targets.size());
+    std::vector< std::vector<long int> > evaluations(targets.size());
+    std::atomic<long int> next(0);
+    std::mutex lock;
+    std::map<long int, CSP*> replicas; /* The instance on every NUMA node with runs */
+    // Every run reserves a slot for each of its local search and evaluation threads
+    long int slots = std::max(params.ls_threads, eval_threads);
+
+    parallelFor(0, threads, threads, [&](long int, long int) {
+        // With NUMA, the first worker on a node copies the instance there
+        CSP* run_csp = csp;
+        if (numaEnabled()) {
+            std::lock_guard<std::mutex> guard(lock);
+            CSP*& replica = replicas[threadNode()];
+            if (replica == NULL)
+                replica = csp->replicate();
+            run_csp = replica;
         }
-    }
-}
-
-/* Initialize the heuristic information matrix */
-void initializeHeuristic () {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    heuristic = new double* [m];
-    for (int i = 0 ; i < m; i++) {
-        heuristic[i] = new double[l];
-        for (int j = 0; j < l; j++) {
-            heuristic[i][j] =
-                (double) csp->getCount(i, j) / (double) csp->getSetSize();
+        for (long int r = next++; r < runs; r = next++) {
+            Parameters run_params = params;
+            run_params.seed = params.seed + r;
+            run_params.verbose = false;
+            ACO aco(run_csp, run_params);
+            while (!aco.terminationCondition() && aco.getBestStringDistance() > hardest) {
+                aco.iterate();
+            }
+            std::vector<Improvement> const& history = aco.getHistory();
+            std::lock_guard<std::mutex> guard(lock);
+            for (size_t t = 0; t < targets.size(); t++) {
+                for (size_t h = 0; h < history.size(); h++) {
+                    if (history[h].quality <= targets[t]) {
+                        seconds[t].push_back(history[h].seconds);
+                        evaluations[t].push_back(history[h].budget + 1);
+                        break;
+                    }
+                }
+            }
+            if (verbose)
+                std::cout << "Run " << r << ": " << aco.getBestStringDistance() << "\n";
         }
-    }
-}
+    }, slots);
 
-/* Initialize the probability information matrix */
-void initializeProbability () {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    probability = new double* [m];
-    for (int i = 0; i < m; i++) {
-        probability[i] = new double[l];
-        for (int j = 0; j < l; j++) {
-            probability[i][j] = 0.0;
-        }
+    for (auto& replica : replicas) {
+        delete replica.second;
     }
-}
 
-/* Calculate probability using heuristic information and pheromone */
-void calculateProbability () {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    for (int i = 0; i < m; i++) {
-        for (int j = 0; j < l; j++) {
-            probability[i][j] =
-                pow(pheromone[i][j], alpha) * pow(heuristic[i][j], beta);
+    std::cout << "target:probability:seconds:evaluations\n";
+    for (size_t t = 0; t < targets.size(); t++) {
+        std::sort(seconds[t].begin(), seconds[t].end());
+        std::sort(evaluations[t].begin(), evaluations[t].end());
+        for (size_t i = 0; i < seconds[t].size(); i++) {
+            printf("%ld:%.4f:%.6f:%ld\n", targets[t], (double) (i + 1) / (double) runs,
+                   seconds[t][i], evaluations[t][i]);
         }
     }
 }
 
-/* Bound pheromone to range [tau_min, tau_max] */
-void boundPheromone(long int i, long int j) {
-    if (pheromone[i][j] > tau_max) {
-        pheromone[i][j] = tau_max;
-    } else if (pheromone[i][j] < tau_min) {
-        pheromone[i][j] = tau_min;
+/* Read the portfolio file. Every line holds the algorithm flags of one configuration, as on the
+   command line; the other parameters are those of the command line. Empty lines and lines
+   starting with # are skipped. tuning/portfolio.txt holds the configurations of run-algorithms.sh */
+std::vector<Configuration> readPortfolio() {
+    std::ifstream infile(portfolio_file);
+    if (!infile.is_open()) {
+        std::cerr << "Failed to open " << portfolio_file << '\n';
+        throw std::invalid_argument("Received an invalid portfolio file");
     }
-}
-
-/* Pheromone evaporation */
-void evaporatePheromone() {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    
-    for (int i = 0; i < m; i++) {
-        for (int j = 0; j < l; j++) {
-            pheromone[i][j] = (double) (1.0 - rho) * pheromone[i][j];
-            if (mmas)
-                boundPheromone(i, j);
+    std::vector<Configuration> configs;
+    std::string line;
+    while (std::getline(infile, line)) {
+        std::istringstream in(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (in >> word) {
+            words.push_back(word);
         }
-    }
-}
-
-/* Pheromone evaporation of best string only */
-void evaporatePheromone(Ant best_ant) {
-    long int l = csp->getStringSize();
-    
-    for (int j = 0; j < l; j++) {
-        // Get the idx in the alphabet of the j'th letter
-        // of the ant's solution string
-        long int i = best_ant.getLetter(j);
-        pheromone[i][j] = (double) (1.0 - rho) * pheromone[i][j];
-        
-        if (mmas) {
-            boundPheromone(i, j);
+        if (words.empty() || words[0][0] == '#')
+            continue;
+        // A flag missing its value reads the empty word after the last one
+        std::string end;
+        std::vector<char*> args;
+        for (size_t w = 0; w < words.size(); w++) {
+            args.push_back(&words[w][0]);
         }
-    }
-}
-
-/* Adds pheromone to the matrix */
-void addPheromone(long int i, long int j, double delta) {
-    pheromone[i][j] = pheromone[i][j] + delta;
-    
-    if (mmas) {
-        boundPheromone(i, j);
-    }
-}
-
-/* Update pheromone */
-void depositPheromone(){
-    long int l = csp->getStringSize();
-    double deltaf;
-    
-    for (int a = 0; a < n_ants; a++) {
-        deltaf = 1.0 - ((double) colony[a].getStringDistance() / (double) l);
-        for (int j = 0; j < l; j++) {
-            // Get the idx in the alphabet of the j'th letter
-            // of the ant's solution string
-            long int i = colony[a].getLetter(j);
-            addPheromone(i, j, deltaf);
-        }
-    }
-}
-
-/* Update pheromone of best string only */
-void depositPheromone(Ant best_ant) {
-    long int m = csp->getAlphabetSize();
-    long int l = csp->getStringSize();
-    double deltaf;
-    
-    if (mmas) {
-        for (int i = 0; i < m; i++) {
-            for (int j = 0; j < l; j++) {
-                long int letter = best_ant.getLetter(j);
-                if (letter == i) {
-                    deltaf = rho * tau_max;
-                } else {
-                    deltaf = rho * tau_min;
-                }
-                addPheromone(i, j, deltaf);
+        args.push_back(&end[0]);
+
+        Configuration config;
+        config.name = line;
+        config.params = params;
+        config.params.as = false;
+        config.params.mmas = false;
+        config.params.acs = false;
+        for (int i = 0; i < (int) words.size(); i++) {
+            if (readAlgorithmArgument(args.data(), i, config.params) <= 0 || i >= (int) words.size()) {
+                std::cerr << "Invalid configuration " << line << '\n';
+                throw std::invalid_argument("Received an invalid portfolio file");
             }
         }
-    } else {
-        deltaf = 1.0 - ((double) best_ant.getStringDistance() / (double) l);
-        for (int j = 0; j < l; j++) {
-            long int i = best_ant.getLetter(j);
-            addPheromone(i, j, deltaf);
+        if (multipleAlgorithms(config.params)) {
+            std::cerr << "Invalid configuration " << line << '\n';
+            throw std::invalid_argument("Received an invalid portfolio file");
         }
+        configs.push_back(config);
     }
+    if (configs.empty())
+        throw std::invalid_argument("Received an empty portfolio file");
+    return configs;
 }
 
-/* Check termination condition based on budget */
-bool terminationCondition(){
-    if (max_budget != 0 && budget >= max_budget)
-        return(true);
-    return(false);
+/* Portfolio mode. Races the configurations of the portfolio file and prints the winner, the
+   budget:quality trace of its best run and its best distance */
+void racePortfolio() {
+    std::vector<Configuration> configs = readPortfolio();
+    Portfolio portfolio(csp, configs, runs, threads, eval_threads, checkpoints, params.max_budget);
+    portfolio.race(verbose);
+
+    long int winner = portfolio.getWinner();
+    ACO& best = portfolio.getBestRun(winner);
+    std::cout << "Winner: " << portfolio.getName(winner) << "\n";
+    std::vector<Improvement> const& history = best.getHistory();
+    for (size_t h = 0; h < history.size(); h++) {
+        printf("%ld:%ld\n", history[h].budget, history[h].quality);
+    }
+    if (verbose) {
+        std::cout << "Evaluations: " << portfolio.getBudget() << " in total, "
+        << best.getBudget() << " by the best run\n";
+        printPlacement();
+    }
+    std::cout << best.getBestStringDistance() << "\n";
 }
 
-/* Free memory used */
-void freeMemory(){
-    
-    delete csp;
-    for(int i = 0; i < csp->getAlphabetSize(); i++){
-        delete[] pheromone[i];
-        delete[] heuristic[i];
-        delete[] probability[i];
+/* Exact search for at most exact_seconds. Prints the optimum, or the lower and upper bound it
+   reached. Returns whether it found the optimum */
+bool solveExact() {
+    double start = wallTime();
+    ExactSolver exact(csp);
+    bool optimal = exact.solve(exact_seconds);
+    if (verbose) {
+        std::cout << "Exact search: " << exact.getClasses() << " classes of columns, "
+        << exact.getNodes() << " nodes in " << wallTime() - start << " s\n";
+        long int* solution = exact.getBestString();
+        std::cout << "Exact solution: distance " << csp->getDistance(solution) << "\n";
+        delete[] solution;
     }
-    delete[] pheromone;
-    delete[] heuristic;
-    delete[] probability;
-    for (int i = 0; i < n_ants; i++) {
-        colony[i].freeAnt();
+    exact_lower_bound = exact.getLowerBound();
+    if (optimal) {
+        std::cout << "Exact: optimum " << exact.getUpperBound() << "\n";
+    } else {
+        std::cout << "Exact: bounds " << exact.getLowerBound() << ":" << exact.getUpperBound() << "\n";
     }
+    return optimal;
 }
 
 /* MAIN */
@@ -405,52 +650,72 @@ int main(int argc, char *argv[] ){
     if(!readArguments(argc, argv)){
         exit(1);
     }
-    
+    setPlacement(pin, numa);
+    placeThread("main", 0);
+
     csp = new CSP(instance_file, verbose);
-    
-    initializeParameters();
-    initializePheromone();
-    initializeHeuristic();
-    initializeProbability();
-    calculateProbability();
-    createColony();
-    
-    // Iterations loop
-    while(!terminationCondition()){
-
-        for(int i = 0; i < n_ants; i++) {
-            // Construct solution
-            colony[i].Search();
-            // If Ant Colony System, do local pheromone update
-            if (acs)
-                colony[i].LocalPheromoneUpdate(pheromone, rho, initial_pheromone);
-            // If local search, do local search
-            if (local)
-                colony[i].LocalSearch(b_rep);
-            // Check for new local optimum
-            if (best_string_len > colony[i].getStringDistance()) {
-                best_string_len = colony[i].getStringDistance();
-                best_ant = colony[i];
-                printf("%ld:%ld\n", budget, best_string_len);
-            }
-            budget++;
-        }
-        // Update pheromones and probabilities
-        evaporatePheromone();
-        if (mmas || acs) {
-            // Only the best ant deposits pheromone
-            depositPheromone(best_ant);
-        } else if (as) {
-            // All ants deposit pheromone
-            depositPheromone();
-        }
-        calculateProbability();
+    csp->setEvaluationThreads(eval_threads);
+    if (reduce) {
+        full_csp = csp;
+        csp = full_csp->reduce();
+        if (verbose)
+            std::cout << "Reduced string length: " << csp->getStringSize()
+            << " positions for " << full_csp->getStringSize() << " columns\n\n";
+    }
+
+    if (exact_seconds > 0 && solveExact()) {
+        long int optimum = exact_lower_bound;
+        delete csp;
+        std::cout << optimum << "\n";
+        return 0;
+    }
+
+    if (portfolio_file != NULL) {
+        racePortfolio();
+        delete csp;
+        delete full_csp;
+        return 0;
+    }
+
+    if (!targets.empty()) {
+        timeToTarget();
+        if (verbose)
+            printPlacement();
+        delete csp;
+        delete full_csp;
+        return 0;
+    }
+
+    ACO* aco = new ACO(csp, params);
+    aco->solve();
+    if (changes_file != NULL)
+        applyChanges(*aco);
+    if (verbose) {
+        aco->printProfile();
+        printPlacement();
+    }
+    long int best_string_len = aco->getBestStringDistance();
+    if (reduce) {
+        // The result is that of the best solution on the full instance
+        long int* solution = csp->expand(aco->getBestString());
+        long int full_len = full_csp->getDistance(solution);
+        delete[] solution;
+        if (full_len != best_string_len)
+            std::cerr << "Reduced distance " << best_string_len << " differs from the full instance: "
+            << full_len << '\n';
+        if (verbose)
+            std::cout << "Best solution on the full instance: " << full_len << "\n";
+        best_string_len = full_len;
     }
     // Free memory
-    freeMemory();
+    delete aco;
+    delete csp;
+    delete full_csp;
     if (verbose) {
         std::cout << "\nEnd ACO execution.\n" << std::endl;
         std::cout << "\nBest solution found: " << best_string_len << "\n";
+        if (exact_seconds > 0)
+            std::cout << "Gap to the exact lower bound: " << best_string_len - exact_lower_bound << "\n";
     }
     std::cout << best_string_len << "\n";
 }
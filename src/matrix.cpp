@@ -0,0 +1,107 @@
+//
+//  matrix.cpp
+//  ACO-CSP
+//
+
+#include "matrix.hpp"
+
+/* Constructor: every cell has the given value */
+SparseMatrix::SparseMatrix(long int m_arg, long int l_arg, double value) {
+    m = m_arg;
+    l = l_arg;
+    baseline.assign(l, value);
+    total.assign(l, 0.0);
+    start.assign(l + 1, 0);
+    for (long int j = 0; j < l; j++) {
+        double sum = 0.0;
+        for (long int i = 0; i < m; i++) {
+            sum = sum + value;
+        }
+        total[j] = sum;
+    }
+}
+
+/* The m values of position j, followed by its baseline */
+void SparseMatrix::expand(long int j, double* row) const {
+    for (long int i = 0; i <= m; i++) {
+        row[i] = baseline[j];
+    }
+    for (long int c = start[j]; c < start[j + 1]; c++) {
+        row[letters[c]] = values[c];
+    }
+}
+
+/* Store the values of position j that differ from its baseline */
+void SparseMatrix::compress(long int j, const double* row, std::vector<long int>& new_start,
+                            std::vector<unsigned char>& new_letters, std::vector<double>& new_values) {
+    new_start[j] = (long int) new_letters.size();
+    baseline[j] = row[m];
+    double sum = 0.0;
+    for (long int i = 0; i < m; i++) {
+        sum = sum + row[i];
+        if (row[i] != row[m]) {
+            new_letters.push_back((unsigned char) i);
+            new_values.push_back(row[i]);
+        }
+    }
+    total[j] = sum;
+}
+
+/* The value of letter i at position j */
+double SparseMatrix::get(long int i, long int j) const {
+    for (long int c = start[j]; c < start[j + 1]; c++) {
+        if (letters[c] == i)
+            return values[c];
+    }
+    return baseline[j];
+}
+
+/* The number of cells stored apart from the baselines */
+long int SparseMatrix::getStoredCells() const {
+    return (long int) letters.size();
+}
+
+/* The letter for the random number u by the random proportional rule. The running sum goes over
+   the letters in order, as on a dense matrix, so the same u gives the same letter. Without the
+   sums of update, the values are added up first */
+long int SparseMatrix::sample(long int j, double u) const {
+    double sum = 0.0;
+    long int c = start[j];
+    if (total.empty()) {
+        for (long int i = 0; i < m; i++) {
+            double value = baseline[j];
+            if (c < start[j + 1] && letters[c] == i)
+                value = values[c++];
+            sum = sum + value;
+        }
+    }
+    double choice = u * (total.empty() ? sum : total[j]);
+    sum = 0.0;
+    c = start[j];
+    for (long int i = 0; i < m - 1; i++) {
+        double value = baseline[j];
+        if (c < start[j + 1] && letters[c] == i)
+            value = values[c++];
+        sum = sum + value;
+        if (choice <= sum)
+            return i;
+    }
+    return m - 1;
+}
+
+/* The first letter with the largest value at position j */
+long int SparseMatrix::argmax(long int j) const {
+    long int letter = -1;
+    double letter_value = 0.0;
+    long int c = start[j];
+    for (long int i = 0; i < m; i++) {
+        double value = baseline[j];
+        if (c < start[j + 1] && letters[c] == i)
+            value = values[c++];
+        if (value > letter_value) {
+            letter = i;
+            letter_value = value;
+        }
+    }
+    return letter;
+}
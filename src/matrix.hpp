@@ -0,0 +1,159 @@
+//
+//  matrix.hpp
+//  ACO-CSP
+//
+
+#ifndef matrix_hpp
+#define matrix_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+/* An m x l matrix of letters by positions that only stores the cells that differ from the
+   baseline of their position. Positions are stored one after the other, as in a compressed
+   sparse row matrix. Updates go position by position and build the cells anew: update expands a
+   row to m values plus the baseline, transform only visits the stored cells and the letters it
+   changes. Every operation applies to the baseline what it applies to any letter it does not
+   single out, so the cells equal to the baseline stay implicit */
+class SparseMatrix {
+
+    long int m;
+    long int l;
+    std::vector<double> baseline;      /* baseline[j]: the value of the cells not stored at j */
+    std::vector<double> total;         /* total[j]: the sum of the values at j, over the letters in
+                                          order. Empty after transform */
+    std::vector<long int> start;       /* the cells of position j are [start[j], start[j+1]) */
+    std::vector<unsigned char> letters;
+    std::vector<double> values;
+
+    void compress(long int j, const double* row, std::vector<long int>& new_start,
+                  std::vector<unsigned char>& new_letters, std::vector<double>& new_values);
+
+public:
+    /* The letters transform sets at one position, in the order they were set */
+    class Row {
+        const SparseMatrix* matrix;
+        long int j;
+        std::vector<long int> set_letters;
+        std::vector<double> set_values;
+        friend class SparseMatrix;
+
+    public:
+        /* The value of letter i: as set, or as before the transform */
+        double get(long int i) const {
+            for (size_t s = 0; s < set_letters.size(); s++) {
+                if (set_letters[s] == i)
+                    return set_values[s];
+            }
+            return matrix->get(i, j);
+        }
+        /* Whether letter i was set */
+        bool isSet(long int i) const {
+            return std::find(set_letters.begin(), set_letters.end(), i) != set_letters.end();
+        }
+        void set(long int i, double value) {
+            for (size_t s = 0; s < set_letters.size(); s++) {
+                if (set_letters[s] == i) {
+                    set_values[s] = value;
+                    return;
+                }
+            }
+            set_letters.push_back(i);
+            set_values.push_back(value);
+        }
+    };
+
+    SparseMatrix(long int m_arg, long int l_arg, double value);
+
+    double get(long int i, long int j) const;
+    /* The m values of position j, followed by its baseline */
+    void expand(long int j, double* row) const;
+    /* The number of cells stored apart from the baselines */
+    long int getStoredCells() const;
+
+    /* Apply op(j, row) to every position j. row holds the m values of the position, followed by
+       the baseline, which op must change as it changes the letters it does not single out */
+    template <class Op> void update(Op op) {
+        std::vector<double> row(m + 1);
+        std::vector<long int> new_start(l + 1);
+        std::vector<unsigned char> new_letters;
+        std::vector<double> new_values;
+        new_letters.reserve(letters.size());
+        new_values.reserve(values.size());
+        total.resize(l);
+        for (long int j = 0; j < l; j++) {
+            expand(j, row.data());
+            op(j, row.data());
+            compress(j, row.data(), new_start, new_letters, new_values);
+        }
+        new_start[l] = (long int) new_letters.size();
+        start.swap(new_start);
+        letters.swap(new_letters);
+        values.swap(new_values);
+    }
+
+    /* At every position j, let op(j, row) set the letters it singles out and apply uniform to the
+       value of every other letter and to the baseline. Takes the stored cells plus the letters set,
+       instead of m per position, and drops the sums */
+    template <class Uniform, class Op> void transform(Uniform uniform, Op op) {
+        Row row;
+        row.matrix = this;
+        std::vector<long int> new_start(l + 1);
+        std::vector<unsigned char> new_letters;
+        std::vector<double> new_values;
+        new_letters.reserve(letters.size());
+        new_values.reserve(values.size());
+        for (long int j = 0; j < l; j++) {
+            row.j = j;
+            row.set_letters.clear();
+            row.set_values.clear();
+            op(j, row);
+            // Merge the stored cells and the letters set, in letter order
+            std::vector<long int> order(row.set_letters.size());
+            for (size_t s = 0; s < order.size(); s++) {
+                order[s] = (long int) s;
+            }
+            std::sort(order.begin(), order.end(), [&row](long int a, long int b) {
+                return row.set_letters[a] < row.set_letters[b];
+            });
+            double base = uniform(baseline[j]);
+            new_start[j] = (long int) new_letters.size();
+            long int c = start[j];
+            size_t s = 0;
+            while (c < start[j + 1] || s < order.size()) {
+                long int i;
+                double value;
+                if (s < order.size() && (c == start[j + 1] || row.set_letters[order[s]] <= letters[c])) {
+                    i = row.set_letters[order[s]];
+                    value = row.set_values[order[s]];
+                    if (c < start[j + 1] && letters[c] == i)
+                        c++;
+                    s++;
+                } else {
+                    i = letters[c];
+                    value = uniform(values[c]);
+                    c++;
+                }
+                if (value != base) {
+                    new_letters.push_back((unsigned char) i);
+                    new_values.push_back(value);
+                }
+            }
+            baseline[j] = base;
+        }
+        new_start[l] = (long int) new_letters.size();
+        start.swap(new_start);
+        letters.swap(new_letters);
+        values.swap(new_values);
+        total.clear();
+    }
+
+    /* The letter at position j for the random number u by the random proportional rule, as
+       Ant::getNextLetter on a dense matrix */
+    long int sample(long int j, double u) const;
+    /* The first letter with the largest value at position j, -1 if all are 0 */
+    long int argmax(long int j) const;
+};
+
+#endif /* matrix_hpp */
@@ -0,0 +1,263 @@
+//
+//  portfolio.cpp
+//  ACO-CSP
+//
+
+#include <iostream>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+#include "portfolio.hpp"
+#include "utils.hpp"
+
+/* Significance level of the racing test */
+static const double race_alpha = 0.05;
+/* Iterations every run does before the first test: the first iterations of a run say little about
+   where it ends up (irace likewise waits for a first batch of instances) */
+static const long int race_first_iterations = 10;
+
+/* Quantile p of the standard normal distribution, by bisection on its distribution function */
+static double normalQuantile(double p) {
+    double low = -10.0;
+    double high = 10.0;
+    for (int step = 0; step < 100; step++) {
+        double mid = (low + high) / 2.0;
+        if (0.5 * erfc(-mid / sqrt(2.0)) < p) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+/* Quantile 1-race_alpha of the chi-square distribution with df degrees of freedom
+   (Wilson-Hilferty approximation) */
+static double chiSquareQuantile(double df) {
+    double z = normalQuantile(1.0 - race_alpha);
+    double a = 2.0 / (9.0 * df);
+    return df * pow(1.0 - a + z * sqrt(a), 3);
+}
+
+/* Quantile 1-race_alpha/2 of Student's t distribution with df degrees of freedom
+   (Cornish-Fisher expansion) */
+static double tQuantile(double df) {
+    double z = normalQuantile(1.0 - race_alpha / 2.0);
+    double z3 = z * z * z;
+    double z5 = z3 * z * z;
+    double z7 = z5 * z * z;
+    return z + (z3 + z) / (4.0 * df) + (5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df)
+        + (3.0 * z7 + 19.0 * z5 + 17.0 * z3 - 15.0 * z) / (384.0 * df * df * df);
+}
+
+/* Constructor. Run r of every configuration has seed seed+r, so the runs of a seed form a block */
+Portfolio::Portfolio(CSP* csp_arg, std::vector<Configuration> const& configs_arg, long int runs_arg,
+                     long int threads_arg, long int eval_threads_arg, long int checkpoints_arg, long int budget) {
+    csp = csp_arg;
+    configs = configs_arg;
+    runs = runs_arg;
+    threads = threads_arg;
+    eval_threads = eval_threads_arg;
+    checkpoints = checkpoints_arg;
+    total_budget = budget * runs * (long int) configs.size();
+
+    acos.resize(configs.size());
+    eliminated.assign(configs.size(), -1);
+    for (size_t c = 0; c < configs.size(); c++) {
+        for (long int r = 0; r < runs; r++) {
+            Parameters run_params = configs[c].params;
+            run_params.seed = configs[c].params.seed + r;
+            run_params.max_budget = budget;
+            run_params.trace = false;
+            run_params.verbose = false;
+            acos[c].push_back(new ACO(csp, run_params));
+        }
+    }
+}
+
+/* Destructor */
+Portfolio::~Portfolio() {
+    for (size_t c = 0; c < acos.size(); c++) {
+        for (size_t r = 0; r < acos[c].size(); r++) {
+            delete acos[c][r];
+        }
+    }
+}
+
+/* The configurations not eliminated */
+std::vector<long int> Portfolio::alive() {
+    std::vector<long int> candidates;
+    for (size_t c = 0; c < configs.size(); c++) {
+        if (eliminated[c] < 0)
+            candidates.push_back(c);
+    }
+    return candidates;
+}
+
+/* rank[a][r]: the rank of candidate a among the candidates on seed r, ties get their mean rank */
+std::vector< std::vector<double> > Portfolio::ranks(std::vector<long int> const& candidates) {
+    long int k = candidates.size();
+    std::vector< std::vector<double> > rank(k, std::vector<double>(runs));
+    for (long int r = 0; r < runs; r++) {
+        for (long int a = 0; a < k; a++) {
+            long int quality = acos[candidates[a]][r]->getBestStringDistance();
+            long int below = 0;
+            long int equal = 0;
+            for (long int b = 0; b < k; b++) {
+                long int other = acos[candidates[b]][r]->getBestStringDistance();
+                if (other < quality) {
+                    below++;
+                } else if (other == quality) {
+                    equal++;
+                }
+            }
+            rank[a][r] = below + (equal + 1) / 2.0;
+        }
+    }
+    return rank;
+}
+
+/* Friedman test over the seeds. If the candidates differ, eliminate those whose rank sum exceeds
+   the best one by more than the critical difference of the post-hoc test. There is no test until
+   every run of the candidates did race_first_iterations iterations */
+void Portfolio::eliminate(long int checkpoint) {
+    std::vector<long int> candidates = alive();
+    long int k = candidates.size();
+    if (k < 2 || runs < 2)
+        return;
+    for (long int a = 0; a < k; a++) {
+        for (long int r = 0; r < runs; r++) {
+            if (acos[candidates[a]][r]->getIterations() < race_first_iterations)
+                return;
+        }
+    }
+
+    std::vector< std::vector<double> > rank = ranks(candidates);
+    std::vector<double> sums(k, 0.0);
+    double squares = 0.0;      /* sum of the squared ranks */
+    double sum_squares = 0.0;  /* sum of the squared rank sums */
+    for (long int a = 0; a < k; a++) {
+        for (long int r = 0; r < runs; r++) {
+            sums[a] += rank[a][r];
+            squares += rank[a][r] * rank[a][r];
+        }
+        sum_squares += sums[a] * sums[a];
+    }
+    double b = (double) runs;
+    double expected = b * (k + 1) / 2.0;
+    double ties = b * k * (k + 1) * (k + 1) / 4.0;
+    // All candidates tied on every seed
+    if (squares - ties <= 0.0)
+        return;
+
+    double statistic = 0.0;
+    for (long int a = 0; a < k; a++) {
+        statistic += (sums[a] - expected) * (sums[a] - expected);
+    }
+    statistic = (k - 1) * statistic / (squares - ties);
+    if (statistic <= chiSquareQuantile(k - 1))
+        return;
+
+    double df = (b - 1.0) * (k - 1);
+    double critical = tQuantile(df) * sqrt(2.0 * (b * squares - sum_squares) / df);
+    double best = *std::min_element(sums.begin(), sums.end());
+    for (long int a = 0; a < k; a++) {
+        if (sums[a] - best > critical)
+            eliminated[candidates[a]] = checkpoint;
+    }
+}
+
+/* Spend the budget in checkpoints. Every checkpoint splits what is left evenly over the runs of the
+   surviving configurations and the checkpoints to go. When there are fewer runs than threads, the
+   runs get the threads left over for their evaluations and local search */
+void Portfolio::race(bool verbose) {
+    for (long int checkpoint = 0; checkpoint < checkpoints; checkpoint++) {
+        std::vector<long int> candidates = alive();
+        std::vector<ACO*> active;
+        long int spare = std::max(threads / (runs * (long int) candidates.size()), 1L);
+        long int slots = std::max(eval_threads, spare); /* placement slots every worker reserves */
+        for (size_t a = 0; a < candidates.size(); a++) {
+            long int ls_threads = std::max(configs[candidates[a]].params.ls_threads, spare);
+            slots = std::max(slots, ls_threads);
+            for (long int r = 0; r < runs; r++) {
+                ACO* aco = acos[candidates[a]][r];
+                aco->setLocalSearchThreads(ls_threads);
+                active.push_back(aco);
+            }
+        }
+        csp->setEvaluationThreads(std::max(eval_threads, spare));
+
+        long int size = active.size();
+        long int left = total_budget - getBudget();
+        long int step = std::max(left / (size * (checkpoints - checkpoint)), 1L);
+        long int workers = std::min(threads, size);
+        std::atomic<long int> next(0);
+        parallelFor(0, workers, workers, [&](long int, long int) {
+            for (long int a = next++; a < size; a = next++) {
+                active[a]->setBudget(active[a]->getBudget() + step);
+                active[a]->solve();
+            }
+        }, slots);
+
+        eliminate(checkpoint);
+        if (verbose)
+            printCheckpoint(checkpoint);
+    }
+    csp->setEvaluationThreads(eval_threads);
+}
+
+/* Print the evaluations spent and the configurations eliminated at a checkpoint */
+void Portfolio::printCheckpoint(long int checkpoint) {
+    std::cout << "Checkpoint " << checkpoint + 1 << ": " << getBudget() << " evaluations, "
+    << alive().size() << " configurations left\n";
+    for (size_t c = 0; c < configs.size(); c++) {
+        if (eliminated[c] == checkpoint)
+            std::cout << "  eliminated: " << configs[c].name << "\n";
+    }
+}
+
+/* The surviving configuration with the smallest rank sum, the first one on ties */
+long int Portfolio::getWinner() {
+    std::vector<long int> candidates = alive();
+    std::vector< std::vector<double> > rank = ranks(candidates);
+    long int winner = candidates[0];
+    double best = 0.0;
+    for (size_t a = 0; a < candidates.size(); a++) {
+        double sum = 0.0;
+        for (long int r = 0; r < runs; r++) {
+            sum += rank[a][r];
+        }
+        if (a == 0 || sum < best) {
+            best = sum;
+            winner = candidates[a];
+        }
+    }
+    return winner;
+}
+
+/* The run of configuration c with the best solution, the first one on ties */
+ACO& Portfolio::getBestRun(long int c) {
+    long int best = 0;
+    for (long int r = 1; r < runs; r++) {
+        if (acos[c][r]->getBestStringDistance() < acos[c][best]->getBestStringDistance())
+            best = r;
+    }
+    return *acos[c][best];
+}
+
+/* The configuration as given */
+std::string const& Portfolio::getName(long int c) {
+    return configs[c].name;
+}
+
+/* Evaluations spent by all runs */
+long int Portfolio::getBudget() {
+    long int spent = 0;
+    for (size_t c = 0; c < acos.size(); c++) {
+        for (size_t r = 0; r < acos[c].size(); r++) {
+            spent += acos[c][r]->getBudget();
+        }
+    }
+    return spent;
+}
@@ -0,0 +1,63 @@
+//
+//  portfolio.hpp
+//  ACO-CSP
+//
+
+#ifndef portfolio_hpp
+#define portfolio_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "aco.hpp"
+#include "csp.hpp"
+
+/* One configuration of the portfolio: an algorithm with its parameters */
+struct Configuration {
+    std::string name;        /* the configuration as given, to report it */
+    Parameters params;
+};
+
+/* Races configurations on one instance. Every configuration runs the same seeds, all runs share
+   the read-only instance. The budget of a run times the number of runs is spent in checkpoints
+   steps, every step splitting what is left evenly over the runs of the surviving configurations.
+   After a step, once every run is past its first iterations, a Friedman test over the seeds
+   eliminates the configurations whose rank sum is significantly worse than the best one. The
+   budget and the threads of eliminated configurations go to the survivors, and the survivor with
+   the best rank sum wins */
+class Portfolio {
+
+    CSP* csp;
+    std::vector<Configuration> configs;
+    long int runs;           /* runs (seeds) of every configuration */
+    long int threads;        /* runs at the same time */
+    long int eval_threads;   /* threads of a full evaluation, at least */
+    long int checkpoints;    /* racing tests, the last one after the whole budget */
+    long int total_budget;   /* evaluations of all runs together */
+
+    std::vector< std::vector<ACO*> > acos; /* acos[c][r]: run r of configuration c */
+    std::vector<long int> eliminated;      /* checkpoint that eliminated a configuration, or -1 */
+
+    std::vector<long int> alive();
+    std::vector< std::vector<double> > ranks(std::vector<long int> const& candidates);
+    void eliminate(long int checkpoint);
+    void printCheckpoint(long int checkpoint);
+
+public:
+    Portfolio(CSP* csp_arg, std::vector<Configuration> const& configs_arg, long int runs_arg,
+              long int threads_arg, long int eval_threads_arg, long int checkpoints_arg, long int budget);
+    ~Portfolio();
+
+    /* Run the race until the budget is spent */
+    void race(bool verbose);
+
+    /* The surviving configuration with the best rank sum */
+    long int getWinner();
+    /* The best run of a configuration */
+    ACO& getBestRun(long int c);
+    std::string const& getName(long int c);
+    long int getBudget();
+};
+
+#endif /* portfolio_hpp */
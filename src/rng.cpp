@@ -0,0 +1,150 @@
+//
+//  rng.cpp
+//  ACO-CSP
+//
+
+#include <stdint.h>
+
+#include "rng.hpp"
+#include "utils.hpp"
+
+/* The top 53 bits of x as a double in (0,1) */
+static inline double toUnit(uint64_t x) {
+    return ((double) (x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/* SplitMix64 finaliser: a bijection that mixes all bits of x */
+static inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/* Park-Miller, as ran01 */
+class LegacyRng : public Rng {
+    long int seed;
+
+public:
+    LegacyRng(long int seed_arg) { seed = seed_arg; }
+    double next() { return ran01(&seed); }
+    void fill(double* out, long int size) {
+        for (long int i = 0; i < size; i++) {
+            out[i] = ran01(&seed);
+        }
+    }
+};
+
+/* xoshiro256** by Blackman and Vigna, seeded with SplitMix64 */
+class XoshiroRng : public Rng {
+    uint64_t s[4];
+
+    inline uint64_t step() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+public:
+    XoshiroRng(long int seed_arg) {
+        uint64_t x = (uint64_t) seed_arg;
+        for (int i = 0; i < 4; i++) {
+            x += 0x9E3779B97F4A7C15ULL;
+            s[i] = mix64(x);
+        }
+    }
+    double next() { return toUnit(step()); }
+    void fill(double* out, long int size) {
+        // The state stays in registers over the whole loop
+        uint64_t s0 = s[0], s1 = s[1], s2 = s[2], s3 = s[3];
+        for (long int i = 0; i < size; i++) {
+            uint64_t result = rotl(s1 * 5, 7) * 9;
+            uint64_t t = s1 << 17;
+            s2 ^= s0;
+            s3 ^= s1;
+            s1 ^= s2;
+            s0 ^= s3;
+            s2 ^= t;
+            s3 = rotl(s3, 45);
+            out[i] = toUnit(result);
+        }
+        s[0] = s0; s[1] = s1; s[2] = s2; s[3] = s3;
+    }
+};
+
+/* PCG32 (XSH-RR) by O'Neill. A number takes two 32 bit outputs */
+class PcgRng : public Rng {
+    uint64_t state;
+    uint64_t inc;
+
+    inline uint32_t step() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = (uint32_t) (((old >> 18) ^ old) >> 27);
+        uint32_t rot = (uint32_t) (old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+public:
+    PcgRng(long int seed_arg) {
+        state = 0;
+        inc = (mix64((uint64_t) seed_arg) << 1) | 1;
+        step();
+        state += (uint64_t) seed_arg;
+        step();
+    }
+    double next() {
+        uint64_t high = step();
+        return toUnit((high << 32) | step());
+    }
+};
+
+/* Counter-based: the i-th number is a mix of the key and i, so a block of numbers has no
+   dependency from one to the next and the fill loop vectorises */
+class CounterRng : public Rng {
+    uint64_t key;
+    uint64_t counter;
+
+public:
+    CounterRng(long int seed_arg) {
+        key = mix64((uint64_t) seed_arg);
+        counter = 0;
+    }
+    double next() { return toUnit(mix64(key + 0x9E3779B97F4A7C15ULL * counter++)); }
+    void fill(double* out, long int size) {
+        for (long int i = 0; i < size; i++) {
+            out[i] = toUnit(mix64(key + 0x9E3779B97F4A7C15ULL * (counter + (uint64_t) i)));
+        }
+        counter += (uint64_t) size;
+    }
+};
+
+/* The next size random numbers */
+void Rng::fill(double* out, long int size) {
+    for (long int i = 0; i < size; i++) {
+        out[i] = next();
+    }
+}
+
+/* A generator of the given kind */
+Rng* Rng::create(RngKind kind, long int seed) {
+    switch (kind) {
+        case RNG_XOSHIRO:
+            return new XoshiroRng(seed);
+        case RNG_PCG:
+            return new PcgRng(seed);
+        case RNG_COUNTER:
+            return new CounterRng(seed);
+        default:
+            return new LegacyRng(seed);
+    }
+}
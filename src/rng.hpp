@@ -0,0 +1,33 @@
+//
+//  rng.hpp
+//  ACO-CSP
+//
+
+#ifndef rng_hpp
+#define rng_hpp
+
+#include <stdio.h>
+
+/* Random number generators */
+enum RngKind {
+    RNG_LEGACY,               /* Park-Miller (ran01), reproduces the published results */
+    RNG_XOSHIRO,              /* xoshiro256** */
+    RNG_PCG,                  /* PCG32 (XSH-RR), two outputs per number */
+    RNG_COUNTER               /* SplitMix64 of a counter: numbers can be generated independently */
+};
+
+/* A source of uniform random numbers in (0,1) */
+class Rng {
+
+public:
+    virtual ~Rng() {}
+    /* The next random number */
+    virtual double next() = 0;
+    /* The next size random numbers, the same as size calls of next */
+    virtual void fill(double* out, long int size);
+
+    /* A generator of the given kind, seeded with seed */
+    static Rng* create(RngKind kind, long int seed);
+};
+
+#endif /* rng_hpp */
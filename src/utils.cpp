@@ -7,6 +7,19 @@
 //
 
 #include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <string.h>
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#endif
 
 #include "utils.hpp"
 
@@ -55,6 +68,276 @@ long int getMaxIdx(long int* arr, long int size) {
     return max_idx;
 }
 
+/* Seconds on a monotonic clock, to measure elapsed time */
+double wallTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Thread placement state */
+struct Placement {
+    long int cpu;
+    long int node;
+};
+static bool place_threads = false;
+static bool place_numa = false;
+static std::vector<long int> place_cpus;          /* the CPUs in the order they are handed out */
+static std::vector<long int> place_nodes;         /* the node of every CPU in place_cpus */
+static std::map<std::string, Placement> placements;
+static std::mutex placement_lock;
+static thread_local std::string thread_name = "main";
+static thread_local long int thread_slot = 0;
+static thread_local long int thread_node = 0;
+
+/* The NUMA node of a CPU, from the nodeN entry in its sysfs directory */
+static long int nodeOfCpu(long int cpu) {
+#ifdef __linux__
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld", cpu);
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+        return 0;
+    long int node = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atol(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+#else
+    (void) cpu;
+    return 0;
+#endif
+}
+
+/* Set up thread placement. The CPUs are those the process may run on; with NUMA they are ordered
+   so that consecutive slots alternate between the nodes */
+void setPlacement(bool pin, bool numa) {
+    place_threads = pin || numa;
+    place_numa = numa;
+    place_cpus.clear();
+    place_nodes.clear();
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (long int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &mask))
+                place_cpus.push_back(c);
+        }
+    }
+#endif
+    if (place_cpus.empty())
+        place_cpus.push_back(0);
+    for (size_t i = 0; i < place_cpus.size(); i++) {
+        place_nodes.push_back(nodeOfCpu(place_cpus[i]));
+    }
+    if (numa) {
+        // Round robin over the nodes: the k-th CPU of every node, for k = 0, 1, ...
+        std::map<long int, std::vector<long int> > by_node;
+        for (size_t i = 0; i < place_cpus.size(); i++) {
+            by_node[place_nodes[i]].push_back(place_cpus[i]);
+        }
+        std::vector<long int> cpus, nodes;
+        for (size_t k = 0; cpus.size() < place_cpus.size(); k++) {
+            for (auto& node : by_node) {
+                if (k < node.second.size()) {
+                    cpus.push_back(node.second[k]);
+                    nodes.push_back(node.first);
+                }
+            }
+        }
+        place_cpus = cpus;
+        place_nodes = nodes;
+    }
+}
+
+/* Whether instance data is replicated per NUMA node */
+bool numaEnabled() {
+    return place_numa;
+}
+
+/* Pin the calling thread to the slot-th CPU and record where it runs */
+long int placeThread(const std::string& name, long int slot) {
+    thread_name = name;
+    thread_slot = slot;
+    if (!place_threads)
+        return thread_node;
+    long int i = slot % (long int) place_cpus.size();
+    long int cpu = place_cpus[i];
+    thread_node = place_nodes[i];
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    long int ran = sched_getcpu();
+    if (ran >= 0)
+        cpu = ran;
+#endif
+    std::lock_guard<std::mutex> guard(placement_lock);
+    Placement placement = { cpu, thread_node };
+    placements[name] = placement;
+    return thread_node;
+}
+
+/* The NUMA node of the calling thread */
+long int threadNode() {
+    return thread_node;
+}
+
+/* Print where every placed thread ran */
+void printPlacement() {
+    if (!place_threads)
+        return;
+    std::lock_guard<std::mutex> guard(placement_lock);
+    printf("\nThread placement:\n");
+    for (auto& placement : placements) {
+        printf("  %s: cpu %ld, node %ld\n", placement.first.c_str(), placement.second.cpu,
+               placement.second.node);
+    }
+}
+
+/* A worker of a parallel loop. It runs one chunk at a time, on the slot the loop asks for */
+struct PoolWorker {
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    const std::function<void(long int, long int)>* body; /* the loop body, NULL while idle */
+    long int begin;
+    long int end;
+    long int slot;            /* slot the chunk runs on */
+    std::string name;         /* name of the thread on that slot */
+    bool stop;
+};
 
+/* The workers of the loops a thread runs at one nesting depth: the calling thread runs a chunk of
+   its loop itself, and the loops nested in that chunk need workers of their own */
+struct PoolLevel {
+    std::vector<PoolWorker*> workers;
+    std::mutex done_lock;
+    std::condition_variable done;
+    long int pending;         /* chunks not finished */
+};
 
+/* The workers of the parallel loops of one thread. They are started, and placed, the first time a
+   loop needs them and then wait for the next chunk, so loops that run often (every block of a
+   local search) start no threads and pin nothing */
+class WorkerPool {
+    std::vector<PoolLevel*> levels;
+    size_t depth;             /* loops of this thread running */
 
+    static void work(PoolLevel* level, PoolWorker* worker);
+
+public:
+    WorkerPool() : depth(0) {}
+    ~WorkerPool();
+    void run(long int begin, long int end, long int threads, long int slots,
+             const std::function<void(long int, long int)>& body);
+};
+static thread_local WorkerPool thread_pool;
+
+/* Stop the workers */
+WorkerPool::~WorkerPool() {
+    for (size_t d = 0; d < levels.size(); d++) {
+        for (size_t t = 0; t < levels[d]->workers.size(); t++) {
+            PoolWorker* worker = levels[d]->workers[t];
+            {
+                std::lock_guard<std::mutex> guard(worker->lock);
+                worker->stop = true;
+            }
+            worker->wake.notify_one();
+            worker->thread.join();
+            delete worker;
+        }
+        delete levels[d];
+    }
+}
+
+/* Loop of a worker: run the chunks it gets. It is only placed again when a chunk asks for
+   another slot */
+void WorkerPool::work(PoolLevel* level, PoolWorker* worker) {
+    long int placed = -1;
+    while (true) {
+        std::unique_lock<std::mutex> guard(worker->lock);
+        worker->wake.wait(guard, [worker]() { return worker->stop || worker->body != NULL; });
+        if (worker->body == NULL)
+            return;
+        const std::function<void(long int, long int)>& body = *worker->body;
+        long int b = worker->begin;
+        long int e = worker->end;
+        if (worker->slot != placed) {
+            placed = worker->slot;
+            placeThread(worker->name, placed);
+        }
+        guard.unlock();
+        body(b, e);
+        guard.lock();
+        worker->body = NULL;
+        guard.unlock();
+        std::lock_guard<std::mutex> done_guard(level->done_lock);
+        if (--level->pending == 0)
+            level->done.notify_one();
+    }
+}
+
+/* Run the chunks of [begin, end) on threads-1 workers of this depth and the calling thread */
+void WorkerPool::run(long int begin, long int end, long int threads, long int slots,
+                     const std::function<void(long int, long int)>& body) {
+    long int size = end - begin;
+    long int chunk = (size + threads - 1) / threads;
+    if (levels.size() == depth)
+        levels.push_back(new PoolLevel());
+    PoolLevel* level = levels[depth];
+    while ((long int) level->workers.size() < threads - 1) {
+        PoolWorker* worker = new PoolWorker();
+        worker->body = NULL;
+        worker->slot = -1;
+        worker->stop = false;
+        worker->thread = std::thread(&WorkerPool::work, level, worker);
+        level->workers.push_back(worker);
+    }
+    depth++;
+    level->pending = 0;
+    for (long int t = 1; t < threads; t++) {
+        long int b = begin + t * chunk;
+        long int e = (b + chunk < end) ? b + chunk : end;
+        if (b >= e)
+            continue;
+        PoolWorker* worker = level->workers[t - 1];
+        {
+            std::lock_guard<std::mutex> guard(level->done_lock);
+            level->pending++;
+        }
+        {
+            std::lock_guard<std::mutex> guard(worker->lock);
+            worker->body = &body;
+            worker->begin = b;
+            worker->end = e;
+            worker->slot = thread_slot + t * slots;
+            worker->name = thread_name + "." + std::to_string(t * slots);
+        }
+        worker->wake.notify_one();
+    }
+    body(begin, (begin + chunk < end) ? begin + chunk : end);
+    std::unique_lock<std::mutex> guard(level->done_lock);
+    level->done.wait(guard, [level]() { return level->pending == 0; });
+    depth--;
+}
+
+/* Split the range [begin, end) in one chunk per thread and run body(chunk_begin, chunk_end) on each.
+   The calling thread takes the first chunk and waits for the others to finish. The other chunks go
+   to the workers of the calling thread (see WorkerPool). Every chunk reserves slots slots: worker t
+   is placed t*slots slots after the caller, so the loops nested in a chunk take the slots after it */
+void parallelFor(long int begin, long int end, long int threads,
+                 const std::function<void(long int, long int)>& body, long int slots) {
+    long int size = end - begin;
+    if (threads > size) threads = size;
+    if (threads <= 1) {
+        if (size > 0) body(begin, end);
+        return;
+    }
+    thread_pool.run(begin, end, threads, std::max(slots, 1L), body);
+}
@@ -10,9 +10,26 @@
 #define utils_hpp
 
 #include <stdio.h>
+#include <functional>
+#include <string>
 
 double ran01(long *idum);
 void move(long int* src, long int* dest, long int size);
 long int getMaxIdx(long int* arr, long int size);
+double wallTime();
+/* Run body over [begin, end) split in threads chunks. Every chunk reserves slots thread placement
+   slots for the loops nested in it */
+void parallelFor(long int begin, long int end, long int threads,
+                 const std::function<void(long int, long int)>& body, long int slots = 1);
+
+/* Thread placement: with pinning every thread gets its own CPU, with NUMA the CPUs alternate
+   between nodes and the threads are pinned as well */
+void setPlacement(bool pin, bool numa);
+bool numaEnabled();
+/* Pin the calling thread to the slot-th CPU and record it under name. Returns its NUMA node */
+long int placeThread(const std::string& name, long int slot);
+/* The NUMA node of the calling thread (0 unless placed) */
+long int threadNode();
+void printPlacement();
 
 #endif /* utils_hpp */